@@ -15,4 +15,8 @@ App::~App()
 void App::Update(float deltaTime)
 {
     cannonGame.UpdateAndDraw(deltaTime);
+
+    perf.Add(PERF_SIMULATION, cannonGame.simulationTime);
+    perf.Add(PERF_PREVIEW, cannonGame.PreviewBuildTime());
+    perf.Draw();
 }
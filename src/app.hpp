@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cannon.hpp"
+#include "perf_overlay.hpp"
 
 class App
 {
@@ -10,7 +11,20 @@ public:
 
 	void Update(float deltaTime);
 
+    // Fires the cannon without the UI (headless runs)
+    void Launch() { cannonGame.Launch(); }
+    void EnableWind() { cannonGame.EnableWind(); }
+    SalvoSettings& GetSalvo() { return cannonGame.Salvo(); }
+    int GetSalvoRounds() const { return cannonGame.SalvoRounds(); }
+    MonteCarloSettings& GetMonteCarlo() { return cannonGame.MonteCarlo(); }
+    long long GetDispersionSamples() const { return cannonGame.DispersionSamples(); }
+    const DispersionStats& GetDispersion() const { return cannonGame.Dispersion(); }
+
+    // Frame timings shown in the "Performance" window
+    PerfOverlay& GetPerf() { return perf; }
+
 private:
+    PerfOverlay perf;
     CannonRenderer cannonRenderer;
     CannonGame cannonGame;
 };
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "simulation.hpp"
+#include "sweep.hpp"
+
+// Headless batch runner: cannon_batch [-j threads] [--pin] [file]
+// Reads one shot per line: p0.x p0.y angle(rad) v0 L M mass
+// Writes one result per line: landed impact.x impact.y flightTime recoil.x recoil.y
+int main(int argc, char* argv[])
+{
+    FILE* input = stdin;
+    int threadCount = 0;
+    bool pinThreads = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pin") == 0)
+        {
+            pinThreads = true;
+        }
+        else
+        {
+            input = fopen(argv[i], "r");
+            if (input == nullptr)
+            {
+                fprintf(stderr, "Cannot open '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+
+    std::vector<Cannon> cannons;
+    Cannon cannon = {};
+    while (fscanf(input, "%f %f %f %f %f %f %f",
+        &cannon.p0.x, &cannon.p0.y, &cannon.angle, &cannon.v0, &cannon.L, &cannon.M, &cannon.projectile.mass) == 7)
+    {
+        cannons.push_back(cannon);
+    }
+
+    if (input != stdin)
+        fclose(input);
+
+    std::vector<ShotResult> results(cannons.size());
+    JobSystem jobs(threadCount, pinThreads);
+    SimulateBatchParallel(jobs, cannons.data(), results.data(), (int)cannons.size());
+
+    for (const ShotResult& result : results)
+    {
+        printf("%d %f %f %f %f %f\n", result.landed ? 1 : 0,
+            result.impact.x, result.impact.y, result.flightTime, result.recoil.x, result.recoil.y);
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#include "bench.hpp"
+
+Bench::Bench(const BenchSettings& settings)
+    : settings(settings)
+{
+    if (this->settings.repetitions < 4)
+        this->settings.repetitions = 4;
+}
+
+uint64_t Bench::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Bench::Selected(const char* name) const
+{
+    return settings.filter == nullptr || strstr(name, settings.filter) != nullptr;
+}
+
+static double Quantile(const std::vector<double>& sorted, double q)
+{
+    double position = q * (sorted.size() - 1);
+    size_t index = (size_t)position;
+    if (index + 1 >= sorted.size())
+        return sorted.back();
+    double t = position - index;
+    return sorted[index] * (1.0 - t) + sorted[index + 1] * t;
+}
+
+void Bench::AddResult(const char* name, std::vector<double>& samples, long long iterations)
+{
+    std::sort(samples.begin(), samples.end());
+
+    // Tukey fences: drop samples disturbed by the OS (preemption, frequency changes...)
+    double q1 = Quantile(samples, 0.25);
+    double q3 = Quantile(samples, 0.75);
+    double iqr = q3 - q1;
+    std::vector<double> kept;
+    for (double sample : samples)
+    {
+        if (sample >= q1 - 1.5 * iqr && sample <= q3 + 1.5 * iqr)
+            kept.push_back(sample);
+    }
+
+    double mean = 0.0;
+    for (double sample : kept)
+        mean += sample;
+    mean /= kept.size();
+
+    double variance = 0.0;
+    for (double sample : kept)
+        variance += (sample - mean) * (sample - mean);
+    variance /= kept.size() > 1 ? kept.size() - 1 : 1;
+
+    BenchResult result;
+    result.name = name;
+    result.nsPerOp = Quantile(kept, 0.5);
+    result.meanNsPerOp = mean;
+    result.stddevNsPerOp = sqrt(variance);
+    result.minNsPerOp = kept.front();
+    result.maxNsPerOp = kept.back();
+    result.opsPerSecond = 1e9 / result.nsPerOp;
+    result.samples = (int)kept.size();
+    result.rejected = (int)(samples.size() - kept.size());
+    result.iterationsPerSample = iterations;
+    results.push_back(result);
+
+    printf("%-36s %12.3f ns/op %14.0f op/s  +-%5.1f%%  (%d outliers)\n", name,
+        result.nsPerOp, result.opsPerSecond, 100.0 * result.stddevNsPerOp / result.meanNsPerOp, result.rejected);
+    fflush(stdout);
+}
+
+bool Bench::WriteJson(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write '%s'\n", path);
+        return false;
+    }
+
+    // One benchmark per line, Compare relies on it
+    fprintf(file, "{\"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(file, "{\"name\": \"%s\", \"ns_per_op\": %.4f, \"mean_ns_per_op\": %.4f, \"stddev_ns_per_op\": %.4f, "
+            "\"min_ns_per_op\": %.4f, \"max_ns_per_op\": %.4f, \"ops_per_second\": %.1f, \"samples\": %d, \"rejected\": %d, "
+            "\"iterations_per_sample\": %lld}%s\n",
+            r.name.c_str(), r.nsPerOp, r.meanNsPerOp, r.stddevNsPerOp, r.minNsPerOp, r.maxNsPerOp, r.opsPerSecond,
+            r.samples, r.rejected, r.iterationsPerSample, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+    return true;
+}
+
+int Bench::Compare(const char* baselinePath, double threshold) const
+{
+    FILE* file = fopen(baselinePath, "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot open baseline '%s'\n", baselinePath);
+        return -1;
+    }
+
+    int regressions = 0;
+    int compared = 0;
+    char line[1024];
+    printf("\n%-36s %12s %12s %8s\n", "Benchmark", "baseline", "current", "change");
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[256];
+        double baseline;
+        const char* nameField = strstr(line, "\"name\": \"");
+        const char* nsField = strstr(line, "\"ns_per_op\": ");
+        if (nameField == nullptr || nsField == nullptr
+            || sscanf(nameField, "\"name\": \"%255[^\"]\"", name) != 1
+            || sscanf(nsField, "\"ns_per_op\": %lf", &baseline) != 1)
+            continue;
+
+        for (const BenchResult& result : results)
+        {
+            if (result.name != name)
+                continue;
+
+            compared++;
+            double change = result.nsPerOp / baseline - 1.0;
+            const char* verdict = "";
+            if (change > threshold)
+            {
+                verdict = "REGRESSION";
+                regressions++;
+            }
+            else if (change < -threshold)
+            {
+                verdict = "faster";
+            }
+            printf("%-36s %12.3f %12.3f %+7.1f%% %s\n", name, baseline, result.nsPerOp, change * 100.0, verdict);
+        }
+    }
+
+    fclose(file);
+    if (compared == 0)
+    {
+        // Wrong file or renamed benchmarks: nothing was checked, which must not pass as no regression
+        fprintf(stderr, "Baseline '%s' has none of the current benchmarks\n", baselinePath);
+        return -1;
+    }
+    return regressions;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Keeps the compiler from optimizing a benchmarked value away
+template<typename T>
+static inline void DoNotOptimize(T& value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    volatile char sink = *(volatile char*)&value;
+    (void)sink;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+struct BenchResult
+{
+    std::string name;
+    double nsPerOp;      // Median of the kept samples
+    double meanNsPerOp;
+    double stddevNsPerOp;
+    double minNsPerOp;
+    double maxNsPerOp;
+    double opsPerSecond;
+    int samples;         // Kept samples
+    int rejected;        // Outliers (outside the 1.5 IQR fences)
+    long long iterationsPerSample;
+};
+
+struct BenchSettings
+{
+    int warmupMs = 50;
+    int repetitions = 30;     // Samples per benchmark
+    double sampleMs = 2.0;    // Minimal duration of a sample, iterations are calibrated to reach it
+    const char* filter = nullptr; // Only run benchmarks whose name contains it
+};
+
+// Runs micro benchmarks: warmup, calibration, repeated samples then outlier rejection
+class Bench
+{
+public:
+    Bench(const BenchSettings& settings);
+
+    // fn runs one call, opsPerCall is the number of operations it does (for ns/op and throughput)
+    template<typename F>
+    void Run(const char* name, int opsPerCall, F fn)
+    {
+        if (!Selected(name))
+            return;
+
+        // Calibrate the iterations of a sample, warming up meanwhile
+        long long iterations = 1;
+        uint64_t warmupStart = NowNs();
+        while (true)
+        {
+            uint64_t start = NowNs();
+            for (long long i = 0; i < iterations; i++)
+                fn();
+            double elapsedMs = (NowNs() - start) / 1e6;
+
+            bool warm = (NowNs() - warmupStart) / 1e6 >= settings.warmupMs;
+            if (elapsedMs >= settings.sampleMs && warm)
+                break;
+            if (elapsedMs < settings.sampleMs)
+                iterations *= 2;
+        }
+
+        std::vector<double> samples(settings.repetitions);
+        for (double& sample : samples)
+        {
+            uint64_t start = NowNs();
+            for (long long i = 0; i < iterations; i++)
+                fn();
+            sample = (double)(NowNs() - start) / ((double)iterations * opsPerCall);
+        }
+
+        AddResult(name, samples, iterations);
+    }
+
+    const std::vector<BenchResult>& Results() const { return results; }
+
+    bool WriteJson(const char* path) const;
+
+    // Compares with a file written by WriteJson, returns the number of benchmarks slower than 1 + threshold
+    // -1 if the baseline can't be read or shares no benchmark with this run
+    int Compare(const char* baselinePath, double threshold) const;
+
+    static uint64_t NowNs();
+
+    // Whether the filter keeps this name, for the checks that run outside Run
+    bool Selected(const char* name) const;
+
+private:
+    void AddResult(const char* name, std::vector<double>& samples, long long iterations);
+
+    BenchSettings settings;
+    std::vector<BenchResult> results;
+};
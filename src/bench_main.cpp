@@ -0,0 +1,612 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <imgui.h>
+
+#include "bench.hpp"
+#include "calc.hpp"
+#include "cannon.hpp"
+#include "dispersion.hpp"
+#include "flight.hpp"
+#include "integrators.hpp"
+#include "preview.hpp"
+#include "preview_worker.hpp"
+#include "projectile_pool.hpp"
+#include "projectile_soa.hpp"
+#include "random.hpp"
+#include "sim_clock.hpp"
+#include "simulation.hpp"
+#include "wind_field.hpp"
+
+// Cost and accuracy of an integrator on the vacuum flight, the closed form gives the exact impact
+template<typename Integrator>
+static void BenchIntegrator(Bench& bench, const Trajectory& trajectory, const IntegratorSettings& settings)
+{
+    std::string name = std::string("IntegrateFlight/") + Integrator::Name();
+    IntegrationStats stats = {};
+    ShotResult result = {};
+    bench.Run(name.c_str(), 1, [&]()
+    {
+        result = IntegrateFlight<Integrator>(GravityModel(), trajectory, settings, stats);
+        DoNotOptimize(result);
+    });
+
+    if (bench.Results().empty() || bench.Results().back().name != name)
+        return;
+    printf("%-36s %6d steps %6d evaluations %4d rejected  impact error %.2e m\n", "", stats.steps,
+        stats.forceEvaluations, stats.rejectedSteps, length(result.impact - trajectory.impact));
+}
+
+// Micro benchmarks of the physics and transform kernels
+// cannon_bench [--filter name] [--reps N] [--json out.json] [--baseline base.json] [--threshold 0.05]
+// Exit code 1 on regressions or a failed check, 2 on bad arguments or a baseline that checks nothing
+int main(int argc, char* argv[])
+{
+    BenchSettings settings;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double threshold = 0.05;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            settings.filter = argv[++i];
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+            settings.repetitions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 2;
+        }
+    }
+
+    Bench bench(settings);
+
+    Cannon cannon = {};
+    cannon.p0       = { -15.f, 1.f };
+    cannon.position = cannon.p0;
+    cannon.angle    = TAU / 8.f;
+    cannon.L        = 5.f;
+    cannon.v0       = 30.f;
+    cannon.M        = 100.f;
+    cannon.projectile.mass = 30.f;
+
+    // Physics
+    {
+        Cannon shot = cannon;
+        float2 point = shot.p0;
+        float time = 0.f;
+        float prevTime = 0.f;
+        bench.Run("UpdateProjectile", 1, [&]()
+        {
+            time += 0.016f;
+            if (!UpdateProjectile(shot, point, prevTime, time))
+            {
+                point = shot.p0;
+                time = prevTime = 0.f;
+            }
+            DoNotOptimize(point);
+        });
+    }
+
+    // Whole flight in a single step: the barrel segment must be cut at the exit and the landing found on the free
+    // flight, on the closed form impact like with small steps
+    bool checkFailed = false;
+    {
+        Cannon shot = cannon;
+        float2 point = shot.p0;
+        float time = 0.f;
+        float prevTime = 0.f;
+        const float largeStep = 7.f;
+        bench.Run("UpdateProjectile/LargeStep", 1, [&]()
+        {
+            point = shot.p0;
+            prevTime = 0.f;
+            time = largeStep;
+            UpdateProjectile(shot, point, prevTime, time);
+            DoNotOptimize(point);
+        });
+
+        if (!bench.Results().empty() && bench.Results().back().name == "UpdateProjectile/LargeStep")
+        {
+            float error = length(point - shot.launch.trajectory.impact);
+            printf("%-36s %.3f s step  impact error %.2e m\n", "", largeStep, error);
+            if (error > 1e-3f)
+            {
+                fprintf(stderr, "UpdateProjectile/LargeStep lands %.3f m off the impact\n", error);
+                checkFailed = true;
+            }
+        }
+    }
+
+    // 1000 Hz ticks at 60 frames per second: every frame is caught up, the simulation runs in real time
+    {
+        FixedStepClock clock(1000.f);
+        int ticks = 0;
+        bench.Run("FixedStepClock/1000Hz", 1, [&]()
+        {
+            ticks += clock.Advance(1.f / 60.f);
+            DoNotOptimize(ticks);
+        });
+
+        if (!bench.Results().empty() && bench.Results().back().name == "FixedStepClock/1000Hz")
+        {
+            FixedStepClock check(1000.f);
+            int simulated = 0;
+            for (int frame = 0; frame < 600; frame++)
+                simulated += check.Advance(1.f / 60.f);
+            int hitch = check.Advance(1.f);
+            printf("%-36s %d ticks in 10 s of frames, %d after a 1 s hitch\n", "", simulated, hitch);
+            if (simulated < 9999 || simulated > 10000 || hitch != 250)
+            {
+                fprintf(stderr, "FixedStepClock/1000Hz drops ticks at 60 fps\n");
+                checkFailed = true;
+            }
+        }
+    }
+
+    bench.Run("SolveTrajectory", 1, [&]()
+    {
+        Trajectory trajectory = SolveTrajectory(cannon);
+        DoNotOptimize(trajectory);
+    });
+
+    {
+        Trajectory trajectory = SolveTrajectory(cannon);
+        float time = 0.f;
+        bench.Run("TrajectoryPosition", 1, [&]()
+        {
+            time = time < trajectory.impactTime ? time + 0.001f : 0.f;
+            float2 position = TrajectoryPosition(trajectory, time);
+            DoNotOptimize(position);
+        });
+    }
+
+    {
+        ShotResult results[256];
+        Cannon cannons[256];
+        for (int i = 0; i < 256; i++)
+        {
+            cannons[i] = cannon;
+            cannons[i].angle = 0.1f + i * 0.005f;
+        }
+        bench.Run("SimulateBatch/256", 256, [&]()
+        {
+            SimulateBatch(cannons, results, 256);
+            DoNotOptimize(results);
+        });
+    }
+
+    {
+        // Closed form of UpdateProjectile over a store of rounds in flight
+        ProjectileSoA store;
+        for (int i = 0; i < 4096; i++)
+            store.Add({ { 0.f, 1.f }, { 10.f, i * 0.01f }, { 0.f, -GRAVITY }, { 0.f, 0.f }, -(i % 64) * 0.1f, FLT_MAX });
+        static float x[4096], y[4096];
+
+        static const char* names[] = { "EvaluateProjectiles/Scalar", "EvaluateProjectiles/SSE", "EvaluateProjectiles/AVX2", "EvaluateProjectiles/AVX-512" };
+        SimdLevel best = DetectSimdLevel();
+        float time = 0.f;
+        for (int level = 0; level <= (int)best; level++)
+        {
+            bench.Run(names[level], store.Count(), [&]()
+            {
+                time += 0.001f;
+                EvaluateProjectiles(store, time, x, y, (SimdLevel)level);
+                DoNotOptimize(x[0]);
+            });
+        }
+    }
+
+    {
+        Trajectory trajectory = SolveTrajectory(cannon);
+        IntegratorSettings settings;
+        BenchIntegrator<ExplicitEuler>(bench, trajectory, settings);
+        BenchIntegrator<SemiImplicitEuler>(bench, trajectory, settings);
+        BenchIntegrator<VelocityVerlet>(bench, trajectory, settings);
+        BenchIntegrator<RK4>(bench, trajectory, settings);
+        BenchIntegrator<DormandPrince45>(bench, trajectory, settings);
+    }
+
+    {
+        // Kilometre range shot: the adaptive steps keep the cost close to the short one
+        static const float speeds[] = { 30.f, 300.f };
+        static const char* names[] = { "SolveFlightPath/30 m/s", "SolveFlightPath/300 m/s" };
+        for (int i = 0; i < 2; i++)
+        {
+            Cannon shot = cannon;
+            shot.v0 = speeds[i];
+            shot.drag = { true, 0.47f, 0.028f, 1.225f };
+            FlightPath path;
+            bench.Run(names[i], 1, [&]()
+            {
+                SolveFlightPath(shot, path);
+                DoNotOptimize(path);
+            });
+            if (!bench.Results().empty() && bench.Results().back().name == names[i])
+                printf("%-36s %6d steps %6d evaluations %4d rejected  range %.1f m (vacuum %.1f m)\n", "", path.stats.steps,
+                    path.stats.forceEvaluations, path.stats.rejectedSteps, path.result.impact.x, SolveTrajectory(shot).impact.x);
+        }
+    }
+
+    {
+        // Counter-based normals: one Philox block per number, the batch paths return the scalar bits
+        static float normals[4096];
+        static const char* names[] = { "RandomNormals/Scalar", "RandomNormals/SSE", "RandomNormals/AVX2", "RandomNormals/AVX-512" };
+        SimdLevel best = DetectSimdLevel();
+        uint64_t first = 0;
+        for (int level = 0; level <= (int)best; level++)
+        {
+            if ((SimdLevel)level == SimdLevel::SSE)
+                continue;
+            bench.Run(names[level], 4096, [&]()
+            {
+                RandomNormals(1, first, 0, normals, 4096, (SimdLevel)level);
+                first += 4096;
+                DoNotOptimize(normals[0]);
+            });
+        }
+    }
+
+    {
+        // Monte Carlo samples, reduced on the fly
+        JobSystem jobs;
+        DispersionSettings settings;
+        settings.sampling = Sampling::Random;
+        DispersionStats stats;
+        uint64_t first = 0;
+        ResetDispersion(stats, SolveTrajectory(cannon).impact);
+        bench.Run("RunDispersion/65536", 65536, [&]()
+        {
+            RunDispersion(jobs, cannon, settings, first, 65536, stats);
+            first += 65536;
+            DoNotOptimize(stats);
+        });
+
+        // Quasi-random points: generation cost on top of the same physics
+        static const char* names[] = { "RunDispersion/65536 sobol", "RunDispersion/65536 halton" };
+        Sampling samplings[] = { Sampling::Sobol, Sampling::Halton };
+        for (int i = 0; i < 2; i++)
+        {
+            DispersionSettings quasi = settings;
+            quasi.sampling = samplings[i];
+            ResetDispersion(stats, SolveTrajectory(cannon).impact);
+            first = 0;
+            bench.Run(names[i], 65536, [&]()
+            {
+                RunDispersion(jobs, cannon, quasi, first, 65536, stats);
+                first += 65536;
+                DoNotOptimize(stats);
+            });
+        }
+
+        Cannon shot = cannon;
+        shot.drag = { true, 0.47f, 0.028f, 1.225f, nullptr, 1.f };
+        ResetDispersion(stats, SolveTrajectory(shot).impact);
+        first = 0;
+        bench.Run("RunDispersion/4096 drag", 4096, [&]()
+        {
+            RunDispersion(jobs, shot, settings, first, 4096, stats);
+            first += 4096;
+            DoNotOptimize(stats);
+        });
+
+        // Through a wind field: the samples of a batch are integrated together, one wind gather per stage
+        WindField wind;
+        wind.Generate(WindSettings(), { -5100.f, GROUND_HEIGHT }, { 1000.f, 500.f }, 5.f);
+        shot.drag.wind = &wind;
+        ResetDispersion(stats, SolveTrajectory(shot).impact);
+        first = 0;
+        bench.Run("RunDispersion/4096 wind", 4096, [&]()
+        {
+            RunDispersion(jobs, shot, settings, first, 4096, stats);
+            first += 4096;
+            DoNotOptimize(stats);
+        });
+
+        // Same impacts as the samples integrated one by one, up to the rounding of the vectorized wind sampling
+        if (!bench.Results().empty() && bench.Results().back().name == "RunDispersion/4096 wind")
+        {
+            DispersionStats batched, single;
+            ResetDispersion(batched, SolveTrajectory(shot).impact);
+            ResetDispersion(single, batched.aim);
+            RunDispersion(jobs, shot, settings, 0, 1024, batched);
+            for (int i = 0; i < 1024; i++)
+            {
+                float steadyWind = 0.f;
+                Cannon sample = DispersionSample(shot, settings, i, steadyWind);
+                DragModel model(sample.drag, sample.projectile.mass);
+                model.steadyWind = { steadyWind, 0.f };
+                IntegrationStats integration;
+                ShotResult result = IntegrateFlight<DormandPrince45>(model, SolveTrajectory(sample), FlightIntegratorSettings(), integration);
+                if (result.landed)
+                    AddImpact(single, result.impact, i);
+            }
+            float error = length(DispersionMean(batched) - DispersionMean(single));
+            printf("%-36s 1024 samples  mean impact error %.2e m\n", "", error);
+            if (batched.landed != single.landed || error > 1e-3f)
+            {
+                fprintf(stderr, "RunDispersion/4096 wind: batched flights land %.3f m off the single ones\n", error);
+                checkFailed = true;
+            }
+        }
+    }
+
+    {
+        // Positions of a salvo: rounds flying close to each other
+        WindField wind;
+        wind.Generate(WindSettings(), { -5100.f, GROUND_HEIGHT }, { 1000.f, 500.f }, 5.f);
+        static float x[4096], y[4096], u[4096], v[4096];
+        for (int i = 0; i < 4096; i++)
+        {
+            x[i] = -15.f - (i % 500) * 2.f + (i / 500) * 9.f;
+            y[i] = 1.f + (i / 500) * 4.f;
+        }
+
+        static const char* names[] = { "WindField::Sample/Scalar", "WindField::Sample/SSE", "WindField::Sample/AVX2", "WindField::Sample/AVX-512" };
+        SimdLevel best = DetectSimdLevel();
+        for (int level = 0; level <= (int)best; level++)
+        {
+            // No gather before AVX2, SSE runs the scalar path
+            if ((SimdLevel)level == SimdLevel::SSE)
+                continue;
+            bench.Run(names[level], 4096, [&]()
+            {
+                wind.Sample(x, y, u, v, 4096, (SimdLevel)level);
+                DoNotOptimize(u[0]);
+            });
+        }
+
+        // Salvo through the wind: every round is stepped on each tick
+        ProjectilePool pool(4096);
+        Cannon shot = cannon;
+        shot.drag = { true, 0.47f, 0.028f, 1.225f, &wind, 1.f };
+        Trajectory trajectories[16];
+        for (int i = 0; i < 16; i++)
+        {
+            shot.angle = 0.3f + i * 0.05f;
+            trajectories[i] = SolveTrajectory(shot);
+        }
+        float k = DragModel(shot.drag, shot.projectile.mass).k;
+        int spawned = 0;
+        bench.Run("ProjectilePool::Step/4096 wind", 4096, [&]()
+        {
+            while (pool.Count() < pool.Capacity())
+                pool.Spawn(trajectories[spawned++ % 16], k, 1.f);
+            pool.Step(0.01f, &wind);
+            DoNotOptimize(pool);
+        });
+
+        // Pooled rounds take the steps of the flight path: each one lands where the preview of its shot does
+        if (!bench.Results().empty() && bench.Results().back().name == "ProjectilePool::Step/4096 wind")
+        {
+            ProjectilePool salvo(16);
+            ProjectileHandle handles[16];
+            float2 impacts[16] = {};
+            for (int i = 0; i < 16; i++)
+                handles[i] = salvo.Spawn(trajectories[i], k, 1.f);
+            for (int tick = 0; tick < 120 * 120 && salvo.Count() > 0; tick++)
+            {
+                salvo.Step(1.f / 120.f, &wind);
+                for (int i = 0; i < 16; i++)
+                {
+                    const PooledProjectile* round = salvo.Get(handles[i]);
+                    if (round != nullptr && round->phase == ProjectilePhase::Drag && round->landed)
+                        impacts[i] = round->end.position;
+                }
+            }
+
+            float maxError = 0.f;
+            for (int i = 0; i < 16; i++)
+            {
+                shot.angle = 0.3f + i * 0.05f;
+                FlightPath path;
+                SolveFlightPath(shot, path, FlightIntegratorSettings());
+                maxError = fmaxf(maxError, length(impacts[i] - path.result.impact));
+            }
+            // The structure of arrays mirror of the pool gives the same positions, between two ticks too
+            static float x[4096], y[4096];
+            pool.Positions(-0.004f, x, y);
+            float mirrorError = 0.f;
+            for (int i = 0; i < pool.Count(); i++)
+                mirrorError = fmaxf(mirrorError, length(float2{ x[i], y[i] } - pool.Position(pool.Data()[i], -0.004f)));
+            printf("%-36s %d rounds  Positions error %.2e m\n", "", pool.Count(), mirrorError);
+            if (mirrorError > 1e-3f)
+            {
+                fprintf(stderr, "ProjectilePool::Positions is %.3f m off Position\n", mirrorError);
+                checkFailed = true;
+            }
+
+            printf("%-36s 16 rounds at 120 Hz  impact error %.2e m\n", "", maxError);
+            if (maxError > 1e-2f)
+            {
+                fprintf(stderr, "ProjectilePool rounds land %.3f m off the flight path\n", maxError);
+                checkFailed = true;
+            }
+        }
+    }
+
+    {
+        // Rounds die at their impact and are spawned again, the pool stays full
+        ProjectilePool pool(4096);
+        Trajectory trajectories[16];
+        for (int i = 0; i < 16; i++)
+        {
+            Cannon shot = cannon;
+            shot.angle = 0.3f + i * 0.05f;
+            trajectories[i] = SolveTrajectory(shot);
+        }
+        int spawned = 0;
+        bench.Run("ProjectilePool::Step/4096", 4096, [&]()
+        {
+            while (pool.Count() < pool.Capacity())
+                pool.Spawn(trajectories[spawned++ % 16]);
+            pool.Step(0.01f);
+            DoNotOptimize(pool);
+        });
+    }
+
+    // float2 operators
+    {
+        float2 a = { 1.f, 2.f };
+        float2 b = { 0.5f, -0.25f };
+        bench.Run("float2 operators", 1, [&]()
+        {
+            DoNotOptimize(b);
+            a = (a + b) * 0.999f - b / float2{ 2.f, 4.f };
+            a += b * b;
+            DoNotOptimize(a);
+        });
+    }
+
+    {
+        float2 point = { 3.f, 4.f };
+        float angle = 0.f;
+        bench.Run("RotateAround", 1, [&]()
+        {
+            angle += 0.001f;
+            RotateAround({ 1.f, 1.f }, point, angle);
+            DoNotOptimize(point);
+        });
+    }
+
+    // Angle then Initial Speed sliders dragged one pixel per 60 fps frame: the prefetch follows the drag step, the
+    // requests hit the cache. The values are rounded to "%.3f" like ImGui does, over a width the worker doesn't know
+    if (bench.Selected("PreviewWorker/Drag"))
+    {
+        PreviewWorker worker;
+        Cannon dragged = cannon;
+        const float sliderWidth = 237.f;
+        const int frames = 60;
+        for (int pixel = 0; pixel < 2 * frames; pixel++)
+        {
+            char text[32];
+            if (pixel < frames)
+            {
+                snprintf(text, sizeof(text), "%.3f", 0.5f + pixel * (TAU / 4.f) / sliderWidth);
+                dragged.angle = strtof(text, nullptr);
+            }
+            else
+            {
+                snprintf(text, sizeof(text), "%.3f", 30.f - (pixel - frames) * 30.f / sliderWidth);
+                dragged.v0 = strtof(text, nullptr);
+            }
+            worker.Request(dragged);
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            worker.Poll();
+        }
+        printf("%-36s %d / %d requests served from the cache\n", "PreviewWorker/Drag", worker.CacheHits(), 2 * frames);
+        if (worker.CacheHits() == 0)
+        {
+            fprintf(stderr, "PreviewWorker/Drag never hits the prefetched previews\n");
+            checkFailed = true;
+        }
+    }
+
+    // Renderer (no window: ImGui context with a fixed display size, fonts never uploaded)
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr; // Don't overwrite the imgui.ini of the game
+    io.DisplaySize = ImVec2(1280.f, 720.f);
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    ImGui::NewFrame();
+
+    {
+        CannonRenderer renderer;
+        renderer.PreUpdate();
+
+        float2 point = { 3.f, 4.f };
+        bench.Run("CannonRenderer::ToPixels", 1, [&]()
+        {
+            DoNotOptimize(point);
+            float2 pixels = renderer.ToPixels(point);
+            DoNotOptimize(pixels);
+        });
+
+        bench.Run("CannonRenderer::ToWorld", 1, [&]()
+        {
+            DoNotOptimize(point);
+            float2 world = renderer.ToWorld(point);
+            DoNotOptimize(world);
+        });
+
+        std::atomic<bool> cancel(false);
+        PreviewCurve preview = {};
+        bench.Run("BuildPreview", 1, [&]()
+        {
+            BuildPreview(cannon, preview, cancel);
+            DoNotOptimize(preview);
+        });
+
+        // Tessellation of the preview into a draw list
+        ImDrawList drawList(ImGui::GetDrawListSharedData());
+        renderer.dl = &drawList;
+        bench.Run("CannonRenderer::DrawTrajectory", 1, [&]()
+        {
+            drawList._ResetForNewFrame();
+            drawList.PushClipRectFullScreen();
+            drawList.PushTextureID(io.Fonts->TexID);
+            renderer.DrawTrajectory(preview.trajectory);
+            DoNotOptimize(drawList.VtxBuffer.Data);
+        });
+
+        // A full salvo pool: without vertex offsets the rounds must stay within the 16 bits indices
+        ProjectilePool salvo(SALVO_POOL_CAPACITY);
+        Trajectory shot = SolveTrajectory(cannon);
+        for (int i = 0; i < SALVO_POOL_CAPACITY; i++)
+            salvo.Spawn(shot);
+        salvo.Step(0.1f);
+        bench.Run("CannonRenderer::DrawRounds", SALVO_POOL_CAPACITY, [&]()
+        {
+            drawList._ResetForNewFrame();
+            drawList.PushClipRectFullScreen();
+            drawList.PushTextureID(io.Fonts->TexID);
+            renderer.DrawRounds(salvo, 0.f);
+            DoNotOptimize(drawList.VtxBuffer.Data);
+        });
+        if (!bench.Results().empty() && bench.Results().back().name == "CannonRenderer::DrawRounds")
+        {
+            printf("%-36s %d rounds  %d vertices\n", "", salvo.Count(), drawList.VtxBuffer.Size);
+            if (drawList.VtxBuffer.Size >= (1 << 16) || drawList.VtxBuffer.Size == 0)
+            {
+                fprintf(stderr, "CannonRenderer::DrawRounds overflows the 16 bits indices\n");
+                checkFailed = true;
+            }
+        }
+        drawList._ClearFreeMemory();
+    }
+
+    ImGui::EndFrame();
+    ImGui::DestroyContext();
+
+    if (jsonPath != nullptr)
+        bench.WriteJson(jsonPath);
+
+    if (baselinePath != nullptr)
+    {
+        int regressions = bench.Compare(baselinePath, threshold);
+        if (regressions < 0)
+            return 2;
+        if (regressions > 0)
+        {
+            printf("%d regression(s) above %.1f%%\n", regressions, threshold * 100.0);
+            return 1;
+        }
+    }
+
+    return checkFailed ? 1 : 0;
+}
@@ -5,6 +5,9 @@
 static const float GRAVITY = 9.80665f;
 static const float TAU = 6.28318530717958f;
 
+// Height of the ground plane, projectiles stop below it (meters)
+static const float GROUND_HEIGHT = -0.5f;
+
 static inline float2 operator+(float2 a, float b) { return { a.x + b, a.y + b }; }
 static inline float2 operator-(float2 a, float b) { return { a.x - b, a.y - b }; }
 static inline float2 operator*(float2 a, float b) { return { a.x * b, a.y * b }; }
@@ -20,3 +23,16 @@ static inline float2& operator/=(float2& a, float2 b) { a = a / b; return a; }
 
 static inline float length(float2 vec) { return sqrtf(vec.x * vec.x + vec.y * vec.y); }
 static inline float sign(float x) { return (x < 0.f) ? -1.f : 1.f; }
+static inline float2 lerp(float2 a, float2 b, float t) { return a + (b - a) * t; }
+
+static inline void RotateAround(const float2& origin, float2& point, const float angle)
+{
+    float c = cosf(angle);
+    float s = sinf(angle);
+    point = point - origin;
+    float2 n_point = {
+        point.x * c - point.y * s,
+        point.x * s + point.y * c
+    };
+    point = n_point + origin;
+}
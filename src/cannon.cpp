@@ -1,15 +1,33 @@
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "calc.hpp"
 #include "cannon.hpp"
+#include "profiler.hpp"
 #include "types.hpp"
 
-#define N_CURVE_POINTS 1000
+// Zoom range of the camera (meters across the display)
+#define VIEW_MIN_WIDTH 1.f
+#define VIEW_MAX_WIDTH 100000.f
+// Zoom factor of one mouse wheel step
+#define VIEW_ZOOM_STEP 1.2f
+// Size of a salvo round on screen (pixels)
+#define ROUND_SIZE 4.f
+// Rounds per PrimReserve, keeps the vertices of a reservation below the 16 bits index limit
+#define ROUND_BATCH 4096
+// Monte Carlo batches are multiples of this many samples, a drag batch stays well below a millisecond per core
+#define MONTE_CARLO_MIN_BATCH 256
 
 CannonRenderer::CannonRenderer()
+    : worldOrigin{ 0.f, 0.f }, worldScale{ 0.f, 0.f }, viewMin{ 0.f, 0.f }, viewMax{ 0.f, 0.f },
+    tessellated(), tessellatedScale(0.f), recorder(nullptr), drawnOrigin{ 0.f, 0.f }, drawnScale{ 0.f, 0.f }
 {
-    curvePoints.reserve(N_CURVE_POINTS);
 }
 
 CannonRenderer::~CannonRenderer()
@@ -19,15 +37,104 @@ CannonRenderer::~CannonRenderer()
 
 void CannonRenderer::PreUpdate()
 {
+    PROFILE_FUNCTION();
     // Get frequently used variables
     dl = ImGui::GetBackgroundDrawList();
     io = &ImGui::GetIO();
 
-    // Compute world space
-    worldOrigin.x = io->DisplaySize.x / 2.f;
-    worldOrigin.y = io->DisplaySize.y - io->DisplaySize.y / 4.f;
-    worldScale.x  = io->DisplaySize.x / 50.f;
-    worldScale.y= -worldScale.x;
+    UpdateCamera();
+
+    // Compute world space, the camera position is drawn at the view anchor
+    worldScale.x  = io->DisplaySize.x / viewWidth;
+    worldScale.y  = -worldScale.x;
+    worldOrigin.x = io->DisplaySize.x / 2.f - cameraPosition.x * worldScale.x;
+    worldOrigin.y = io->DisplaySize.y - io->DisplaySize.y / 4.f - cameraPosition.y * worldScale.y;
+
+    float2 topLeft     = ToWorld({ 0.f, 0.f });
+    float2 bottomRight = ToWorld({ io->DisplaySize.x, io->DisplaySize.y });
+    viewMin = { topLeft.x, bottomRight.y };
+    viewMax = { bottomRight.x, topLeft.y };
+
+    // Recorded pixels are stale once the world to pixels transform changed (resize, pan, zoom)
+    if (drawnOrigin.x != worldOrigin.x || drawnOrigin.y != worldOrigin.y || drawnScale.x != worldScale.x)
+    {
+        drawnOrigin = worldOrigin;
+        drawnScale = worldScale;
+        InvalidateDrawCache();
+    }
+}
+
+void CannonRenderer::UpdateCamera()
+{
+    // The UI keeps the mouse, and nothing to anchor on before the first frame
+    if (io->WantCaptureMouse || worldScale.x == 0.f)
+        return;
+
+    if (ImGui::IsMouseDown(ImGuiMouseButton_Left) || ImGui::IsMouseDown(ImGuiMouseButton_Middle))
+    {
+        cameraPosition.x -= io->MouseDelta.x / worldScale.x;
+        cameraPosition.y -= io->MouseDelta.y / worldScale.y;
+    }
+
+    if (io->MouseWheel != 0.f && ImGui::IsMousePosValid())
+    {
+        // The world point under the cursor stays under it
+        float2 mouse  = { io->MousePos.x, io->MousePos.y };
+        float2 anchor = ToWorld(mouse);
+        viewWidth = viewWidth * powf(VIEW_ZOOM_STEP, -io->MouseWheel);
+        viewWidth = fminf(fmaxf(viewWidth, VIEW_MIN_WIDTH), VIEW_MAX_WIDTH);
+
+        float scale = io->DisplaySize.x / viewWidth;
+        cameraPosition.x = anchor.x - (mouse.x - io->DisplaySize.x / 2.f) / scale;
+        cameraPosition.y = anchor.y + (mouse.y - (io->DisplaySize.y - io->DisplaySize.y / 4.f)) / scale;
+    }
+}
+
+void CannonRenderer::ResetCamera()
+{
+    cameraPosition = { 0.f, 0.f };
+    viewWidth = 50.f;
+}
+
+bool CannonRenderer::IsVisible(float2 min, float2 max) const
+{
+    return max.x >= viewMin.x && min.x <= viewMax.x && max.y >= viewMin.y && min.y <= viewMax.y;
+}
+
+void CannonRenderer::InvalidateDrawCache()
+{
+    groundCache.dirty = true;
+    cannonCache.dirty = true;
+    trajectoryCache.dirty = true;
+    projectileCache.dirty = true;
+    windCache.dirty = true;
+}
+
+template<typename F>
+void CannonRenderer::DrawCached(DrawCache& cache, F draw)
+{
+    if (!useDrawCache)
+    {
+        draw();
+        return;
+    }
+
+    if (cache.dirty)
+    {
+        // Same setup as the background draw list, only the vertices and indices are kept
+        recorder._Data = ImGui::GetDrawListSharedData();
+        recorder._ResetForNewFrame();
+        recorder.PushClipRectFullScreen();
+        recorder.PushTextureID(io->Fonts->TexID);
+
+        ImDrawList* target = dl;
+        dl = &recorder;
+        draw();
+        dl = target;
+        cache.Store(recorder);
+    }
+
+    cache.Replay(dl);
 }
 
 float2 CannonRenderer::ToPixels(float2 coordinatesInMeters)
@@ -40,153 +147,323 @@ float2 CannonRenderer::ToWorld(float2 coordinatesInPixels)
     return (coordinatesInPixels - worldOrigin) / worldScale;
 }
 
-void CannonRenderer::DrawGround()
+void CannonRenderer::ToPixels(const float2* coordinatesInMeters, ImVec2* pixels, int count)
 {
-    float2 left  = this->ToPixels({ -100.f, -0.5f });
-    float2 right = this->ToPixels({ +100.f, -0.5f });
+    static_assert(sizeof(float2) == 2 * sizeof(float) && sizeof(ImVec2) == 2 * sizeof(float), "Points are read as float arrays");
+    const float* in = &coordinatesInMeters->x;
+    float* out = &pixels->x;
+    int i = 0;
+
+#if defined(SIMD_SSE2)
+    // Two points per register: x0 y0 x1 y1
+    __m128 scale  = _mm_setr_ps(worldScale.x, worldScale.y, worldScale.x, worldScale.y);
+    __m128 origin = _mm_setr_ps(worldOrigin.x, worldOrigin.y, worldOrigin.x, worldOrigin.y);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(in + 2 * i);
+        __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        _mm_storeu_ps(out + 2 * i,     _mm_add_ps(_mm_mul_ps(a, scale), origin));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_add_ps(_mm_mul_ps(b, scale), origin));
+    }
+#endif
 
-    dl->AddLine(left, right, IM_COL32_WHITE);
+    for (; i < count; i++)
+    {
+        out[2 * i]     = in[2 * i]     * worldScale.x + worldOrigin.x;
+        out[2 * i + 1] = in[2 * i + 1] * worldScale.y + worldOrigin.y;
+    }
 }
 
-inline void RotateAround(const float2& origin, float2& point, const float angle)
+void CannonRenderer::DrawGround()
 {
-    point = point - origin;
-    float2 n_point = {
-        point.x * cosf(angle) - point.y * sinf(angle),
-        point.x * sinf(angle) + point.y * cosf(angle)
-    };
-    point = n_point + origin;
+    PROFILE_FUNCTION();
+    DrawCached(groundCache, [this]()
+    {
+        // The ground spans the whole view
+        if (GROUND_HEIGHT < viewMin.y || GROUND_HEIGHT > viewMax.y)
+            return;
+
+        float2 left  = this->ToPixels({ viewMin.x, GROUND_HEIGHT });
+        float2 right = this->ToPixels({ viewMax.x, GROUND_HEIGHT });
+
+        dl->AddLine(left, right, IM_COL32_WHITE);
+    });
 }
 
 void CannonRenderer::DrawCannon(const Cannon& cannon)
 {
-	float2 o = cannon.position;
-    float2 wheelPosition = {2.0f, 0};
-	const float hW  = cannon.L;
-	const float hH = 0.5f;
-    float2 p[4];
-	p[0] =  this->ToPixels({o.x + hW, o.y + hH});
-	p[1] =  this->ToPixels({o.x     , o.y + hH});
-	p[2] =  this->ToPixels({o.x     , o.y - hH});
-	p[3] =  this->ToPixels({o.x + hW, o.y - hH});
-
-    for (int i = 0; i < 4; i++)
-		RotateAround(this->ToPixels(o), p[i], -cannon.angle);
+    PROFILE_FUNCTION();
+    float key[] = { cannon.position.x, cannon.position.y, cannon.angle, cannon.L };
+    cannonCache.SetKey(key, sizeof(key));
 
-    dl->AddQuad(p[0], p[1], p[2], p[3], IM_COL32_WHITE);
-
-    dl->AddCircle(
-        this->ToPixels(cannon.position + wheelPosition), 1.f * worldScale.x, IM_COL32_WHITE);
+    DrawCached(cannonCache, [&]()
+    {
+        // Barrel and wheel fit in a circle of L + 3 meters around the breech
+        float radius = cannon.L + 3.f;
+        if (!IsVisible(cannon.position - radius, cannon.position + radius))
+            return;
+
+        float2 o = cannon.position;
+        float2 wheelPosition = {2.0f, 0};
+        const float hW  = cannon.L;
+        const float hH = 0.5f;
+        float2 p[4];
+        p[0] =  this->ToPixels({o.x + hW, o.y + hH});
+        p[1] =  this->ToPixels({o.x     , o.y + hH});
+        p[2] =  this->ToPixels({o.x     , o.y - hH});
+        p[3] =  this->ToPixels({o.x + hW, o.y - hH});
+
+        for (int i = 0; i < 4; i++)
+        	RotateAround(this->ToPixels(o), p[i], -cannon.angle);
+
+        dl->AddQuad(p[0], p[1], p[2], p[3], IM_COL32_WHITE);
+
+        dl->AddCircle(
+            this->ToPixels(cannon.position + wheelPosition), 1.f * worldScale.x, IM_COL32_WHITE);
+    });
 }
 
-bool UpdateProjectile(Cannon &cannon, float2 &projectilePos, float &prevTime, float &time)
+// Segments whose bounding box touches the view
+static inline bool SegmentVisible(const CannonRenderer& renderer, float2 a, float2 b)
 {
-    Projectile* projectile = &cannon.projectile;
-    float cannonXLength = cosf(cannon.angle) * cannon.L;
-
-    // v^2 - v0^2 = 2aL;
-    // v^2        = 2aL + v0^2;
-    // v          = sqrt(2aL + v0^2);
-    float exitSpeed = sqrtf(2 * -length(projectile->acceleration) * cannon.L + cannon.v0 * cannon.v0);
+    return renderer.IsVisible({ fminf(a.x, b.x), fminf(a.y, b.y) }, { fmaxf(a.x, b.x), fmaxf(a.y, b.y) });
+}
 
-    //We check if the projectile is at 0 minus the radius
-    bool isFinished = projectilePos.y < -0.5;
+static inline bool SameFloat2(float2 a, float2 b)
+{
+    return a.x == b.x && a.y == b.y;
+}
 
-    // Or if the projectile went backwards in the cannon then we now if we should stop
-    isFinished |= projectilePos.x - cannon.p0.x < 0;
+// Field by field: Trajectory has padding after exits, its bytes are not a key
+static bool SameTrajectory(const Trajectory& a, const Trajectory& b)
+{
+    return a.exits == b.exits && SameFloat2(a.p0, b.p0) && SameFloat2(a.direction, b.direction) && a.v0 == b.v0
+        && a.exitTime == b.exitTime && SameFloat2(a.exitPoint, b.exitPoint) && SameFloat2(a.exitSpeed, b.exitSpeed)
+        && a.apexTime == b.apexTime && SameFloat2(a.apex, b.apex) && a.impactTime == b.impactTime
+        && SameFloat2(a.impact, b.impact) && SameFloat2(a.recoilSpeed, b.recoilSpeed);
+}
 
-    //We check if the position in x is bigger than the cannon length in x
-    bool isInsideCanon = projectilePos.x - cannon.p0.x < cannonXLength;
+void CannonRenderer::DrawTrajectory(const Trajectory& trajectory)
+{
+    PROFILE_FUNCTION();
+    // Level of detail: tessellated for the next power of two scale, again for a new shot or another level
+    float scale = exp2f(ceilf(log2f(fabsf(worldScale.x))));
+    if (!SameTrajectory(tessellated, trajectory) || scale != tessellatedScale)
+    {
+        tessellated = trajectory;
+        tessellatedScale = scale;
+        TessellateTrajectory(trajectory, curveTolerance / scale, trajectoryPoints);
+        trajectoryPixels.resize(trajectoryPoints.size());
+    }
 
-    bool canBeOutOfCannon = exitSpeed > 0;
+    DrawWorldPolyline(trajectoryPoints);
+}
 
-    float2 p0 = cannon.p0;
-    float2 v0 = projectile->speed;
-    float t = time;
+void CannonRenderer::DrawFlightPath(const FlightPath& path)
+{
+    PROFILE_FUNCTION();
+    // The drawn layer is cached by the caller, the path is only tessellated when it is redrawn
+    float scale = exp2f(ceilf(log2f(fabsf(worldScale.x))));
+    TessellateFlightPath(path, curveTolerance / scale, trajectoryPoints);
+    trajectoryPixels.resize(trajectoryPoints.size());
+    // The points no longer match the last trajectory
+    tessellatedScale = 0.f;
+
+    DrawWorldPolyline(trajectoryPoints);
+}
 
-    if (isFinished)
+void CannonRenderer::DrawWorldPolyline(const std::vector<float2>& worldPoints)
+{
+    // Only the runs of visible segments are transformed and drawn
+    const float2* points = worldPoints.data();
+    int last = (int)worldPoints.size() - 1;
+    int i = 0;
+    while (i < last)
     {
-        projectile->launched = false;
-        return (false);
+        while (i < last && !SegmentVisible(*this, points[i], points[i + 1]))
+            i++;
+        if (i == last)
+            break;
+
+        int first = i;
+        while (i < last && SegmentVisible(*this, points[i], points[i + 1]))
+            i++;
+
+        int count = i - first + 1;
+        ToPixels(points + first, trajectoryPixels.data(), count);
+        dl->AddPolyline(trajectoryPixels.data(), count, IM_COL32_WHITE, ImDrawFlags_None, 1.f);
     }
-    else if (isInsideCanon)
+}
+
+void CannonRenderer::DrawProjectileMotion(const Cannon& cannon, const PreviewCurve& preview)
+{
+    PROFILE_FUNCTION();
+    // Nothing to draw until the first preview is computed
+    unsigned int trajectoryKey[] = { preview.valid ? 1u : 0u, preview.generation };
+    trajectoryCache.SetKey(trajectoryKey, sizeof(trajectoryKey));
+    DrawCached(trajectoryCache, [&]()
     {
-        float2 p0 = cannon.p0;
-        t = time;
-        v0 = projectile->speed =
-        {
-            cannon.v0 * cosf(cannon.angle),
-            cannon.v0 * sinf(cannon.angle)
-        };
-        projectile->acceleration = { -GRAVITY * cosf(cannon.angle), -GRAVITY * sinf(cannon.angle) };
-        prevTime = time;
-    }
-    else if (canBeOutOfCannon)
+        if (preview.valid && preview.drag)
+            DrawFlightPath(preview.path);
+        else if (preview.valid)
+            DrawTrajectory(preview.trajectory);
+    });
+
+    //Draw projectile itself
+    projectileCache.SetKey(&cannon.projectile.position, sizeof(float2));
+    DrawCached(projectileCache, [&]()
     {
-        p0 =
-        {
-            cosf(cannon.angle) * cannon.L + cannon.p0.x,
-            sinf(cannon.angle) * cannon.L + cannon.p0.y
-        };
-        t = time - prevTime;
-        v0 = projectile->speed =
-        {
-            exitSpeed * cosf(cannon.angle),
-            exitSpeed * sinf(cannon.angle)
-        };
-        projectile->acceleration = { 0, -GRAVITY };
-    }
+        float radius = 10.f / fabsf(worldScale.x);
+        if (!IsVisible(cannon.projectile.position - radius, cannon.projectile.position + radius))
+            return;
 
-    //p(t) = p0 + v0 * t + (a * t^2 * 0.5f)
-    projectilePos =  p0 + v0 * t + (projectile->acceleration * t * t * 0.5f);
+        dl->AddCircle(
+            this->ToPixels(cannon.projectile.position), 10.f, IM_COL32_WHITE);
+    });
+}
 
-    //Inelastic collision : Qac+ Qab = Qqpc + QqpB ; m*v0 = mv+mv` ; v` = m(v0 - v) / M
-    //In our case both our initial speeds are 0 before collision
-    float2 cannonVelocity = {
-        cannon.projectile.mass * (-cannon.v0) / cannon.M * cosf(cannon.angle),
-        0
-    };
+void CannonRenderer::DrawRounds(const ProjectilePool& pool, float timeOffset)
+{
+    PROFILE_FUNCTION();
+    roundX.resize(pool.Count());
+    roundY.resize(pool.Count());
+    pool.Positions(timeOffset, roundX.data(), roundY.data());
+    float margin = ROUND_SIZE / fabsf(worldScale.x);
+
+    // Each batch stays below the 16 bits index limit, PrimReserve starts a new vertex offset for it when the renderer
+    // supports it. Otherwise the draw list holds 64K vertices in total and the rounds past that are not drawn.
+    bool vtxOffset = sizeof(ImDrawIdx) > 2 || (dl->Flags & ImDrawListFlags_AllowVtxOffset);
+    for (int first = 0; first < pool.Count(); first += ROUND_BATCH)
+    {
+        int count = pool.Count() - first < ROUND_BATCH ? pool.Count() - first : ROUND_BATCH;
+        if (!vtxOffset)
+        {
+            int room = (int)((1 << 16) - 1 - dl->_VtxCurrentIdx) / 4;
+            if (room <= 0)
+                break;
+            count = count < room ? count : room;
+        }
 
-    cannon.position = cannon.p0 + cannonVelocity * time;
-    return (true);
+        // One reservation for the whole batch, the culled rounds are given back
+        dl->PrimReserve(count * 6, count * 4);
+        int drawn = 0;
+        for (int i = first; i < first + count; i++)
+        {
+            float2 position = { roundX[i], roundY[i] };
+            if (!IsVisible(position - margin, position + margin))
+                continue;
+
+            float2 pixels = ToPixels(position);
+            dl->PrimRect(ImVec2(pixels.x - ROUND_SIZE * 0.5f, pixels.y - ROUND_SIZE * 0.5f),
+                ImVec2(pixels.x + ROUND_SIZE * 0.5f, pixels.y + ROUND_SIZE * 0.5f), IM_COL32_WHITE);
+            drawn++;
+        }
+        dl->PrimUnreserve((count - drawn) * 6, (count - drawn) * 4);
+    }
 }
 
-void CannonRenderer::DrawProjectileMotion(const Cannon& cannon, bool update)
+void CannonRenderer::DrawWind(const WindField& wind, float windScale)
 {
-    Projectile *p = (Projectile *)&cannon.projectile;
-    float time = 0;
-    float dTime = 0.016f;
-    float prevTime = 0;
-    if (update)
+    PROFILE_FUNCTION();
+    uint32_t key[] = { wind.Id(), 0 };
+    memcpy(&key[1], &windScale, sizeof(float));
+    windCache.SetKey(key, sizeof(key));
+    DrawCached(windCache, [&]()
     {
-        update = false;
-        float2 point = cannon.p0;
-        this->curvePoints.clear();
+        // One arrow every ARROW_SPACING pixels, sampled in one batch
+        const float ARROW_SPACING = 64.f;
+        const float PIXELS_PER_SPEED = 3.f; // Arrow length of 1 m/s
+        int columns = (int)(io->DisplaySize.x / ARROW_SPACING) + 1;
+        int rows = (int)(io->DisplaySize.y / ARROW_SPACING) + 1;
+        int count = columns * rows;
+        arrowX.resize(count);
+        arrowY.resize(count);
+        arrowU.resize(count);
+        arrowV.resize(count);
+        for (int j = 0; j < rows; j++)
+        {
+            for (int i = 0; i < columns; i++)
+            {
+                float2 world = ToWorld({ (i + 0.5f) * ARROW_SPACING, (j + 0.5f) * ARROW_SPACING });
+                arrowX[j * columns + i] = world.x;
+                arrowY[j * columns + i] = world.y;
+            }
+        }
+        wind.Sample(arrowX.data(), arrowY.data(), arrowU.data(), arrowV.data(), count);
 
-        this->curvePoints.push_back(this->ToPixels(point));
-        for (size_t i = 0; i < this->curvePoints.capacity(); i++)
+        ImU32 color = IM_COL32(110, 150, 255, 140);
+        for (int k = 0; k < count; k++)
         {
-            time += dTime;
-            UpdateProjectile((Cannon&)cannon, point, prevTime, time);
-            //Early exit if finished
-            if (point.y < -0.5 || point.x - cannon.p0.x < 0)
-                break;
-            else
-                this->curvePoints.push_back(this->ToPixels(point));
+            // Nothing blows under the ground
+            if (arrowY[k] < GROUND_HEIGHT)
+                continue;
+
+            float2 start = ToPixels({ arrowX[k], arrowY[k] });
+            float2 d = float2{ arrowU[k], -arrowV[k] } * (windScale * PIXELS_PER_SPEED);
+            float size = length(d);
+            if (size < 1.f)
+                continue;
+            if (size > ARROW_SPACING * 0.8f)
+            {
+                d = d * (ARROW_SPACING * 0.8f / size);
+                size = ARROW_SPACING * 0.8f;
+            }
+
+            float2 end = start + d;
+            float2 back = d * (-4.f / size);
+            float2 side = { -back.y * 0.5f, back.x * 0.5f };
+            dl->AddLine(start, end, color);
+            dl->AddLine(end, end + back + side, color);
+            dl->AddLine(end, end + back - side, color);
         }
-    }
-    for (size_t i = 1; i < curvePoints.size(); i++)
+    });
+}
+
+void CannonRenderer::DrawDispersion(const DispersionStats& stats, float sigmas)
+{
+    PROFILE_FUNCTION();
+    if (stats.landed < 2)
+        return;
+
+    // Principal axes of the covariance
+    float xx, xy, yy;
+    DispersionCovariance(stats, xx, xy, yy);
+    float center = 0.5f * (xx + yy);
+    float offset = sqrtf(0.25f * (xx - yy) * (xx - yy) + xy * xy);
+    float major = sigmas * sqrtf(center + offset);
+    float minor = sigmas * sqrtf(fmaxf(center - offset, 0.f));
+    float angle = 0.5f * atan2f(2.f * xy, xx - yy);
+    float2 axis = { cosf(angle), sinf(angle) };
+    float2 normal = { -axis.y, axis.x };
+    float2 mean = DispersionMean(stats);
+
+    // Impacts lie on the ground: the ellipse is usually flat, the CEP circle shows the spread anyway
+    float cep = DispersionCEP(stats);
+    float extent = fmaxf(major, cep);
+    if (!IsVisible(mean - extent - fabsf(mean.x - stats.aim.x), mean + extent + fabsf(mean.x - stats.aim.x)))
+        return;
+
+    const int SEGMENTS = 64;
+    float2 points[SEGMENTS];
+    ImVec2 pixels[SEGMENTS];
+    for (int i = 0; i < SEGMENTS; i++)
     {
-        dl->AddLine(curvePoints[i-1], curvePoints[i], IM_COL32_WHITE);
+        float t = TAU * i / SEGMENTS;
+        points[i] = mean + axis * (major * cosf(t)) + normal * (minor * sinf(t));
     }
-
-    //Draw projectile itself
-    dl->AddCircle(
-        this->ToPixels(cannon.projectile.position), 10.f, IM_COL32_WHITE);
+    ToPixels(points, pixels, SEGMENTS);
+    dl->AddPolyline(pixels, SEGMENTS, IM_COL32(255, 170, 60, 255), ImDrawFlags_Closed, 1.5f);
+
+    float2 aim = ToPixels(stats.aim);
+    dl->AddCircle(aim, cep * fabsf(worldScale.x), IM_COL32(80, 220, 120, 255), 0, 1.f);
+    float2 meanPixels = ToPixels(mean);
+    dl->AddLine(ImVec2(meanPixels.x - 4.f, meanPixels.y), ImVec2(meanPixels.x + 4.f, meanPixels.y), IM_COL32(255, 170, 60, 255));
+    dl->AddLine(ImVec2(meanPixels.x, meanPixels.y - 4.f), ImVec2(meanPixels.x, meanPixels.y + 4.f), IM_COL32(255, 170, 60, 255));
 }
 
-void CannonRenderer::DrawImgui(Cannon& cannon, bool &updated)
+void CannonRenderer::DrawImgui(Cannon& cannon, const WindField& wind, bool &updated)
 {
+    PROFILE_FUNCTION();
     if (ImGui::Begin("Cannon settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
     {
         if (ImGui::Button(cannon.projectile.launched ? "Simulating" : "Launch") && !cannon.projectile.launched)
@@ -194,12 +471,15 @@ void CannonRenderer::DrawImgui(Cannon& cannon, bool &updated)
             updated = true;
             cannon.projectile.launched = true;
             cannon.projectile.position = cannon.p0;
-
-            this->curvePoints.clear();
         }
 
         ImGui::NewLine();
         ImGui::SliderFloat("Time Scale", &timeScale, 0.f, 2.f);
+        ImGui::SliderFloat("Tick Rate", &tickRate, 10.f, 1000.f, "%.0f Hz");
+        ImGui::Checkbox("Cache static geometry", &useDrawCache);
+        ImGui::SliderFloat("View Width", &viewWidth, VIEW_MIN_WIDTH, VIEW_MAX_WIDTH, "%.0f m", ImGuiSliderFlags_Logarithmic);
+        if (ImGui::Button("Reset View"))
+            ResetCamera();
         ImGui::NewLine();
 
         if (!cannon.projectile.launched)
@@ -211,6 +491,33 @@ void CannonRenderer::DrawImgui(Cannon& cannon, bool &updated)
             updated |= ImGui::SliderFloat("Angle", &cannon.angle, 0.f, TAU / 4.f);
             updated |= ImGui::SliderFloat("Initial Speed", &cannon.v0, 0.f, 30.f);
             updated |= ImGui::SliderFloat("Projectile Mass", &cannon.projectile.mass, 10.f, 100.f);
+
+            updated |= ImGui::Checkbox("Air Drag", &cannon.drag.enabled);
+            if (cannon.drag.enabled)
+            {
+                updated |= ImGui::SliderFloat("Drag Coefficient", &cannon.drag.dragCoefficient, 0.05f, 1.f, "%.3f");
+                // Edited in cm^2, stored in m^2
+                float area = cannon.drag.area * 1e4f;
+                if (ImGui::SliderFloat("Cross Section", &area, 1.f, 500.f, "%.0f cm2"))
+                {
+                    cannon.drag.area = area / 1e4f; // Same rounding as the preview keys
+                    updated = true;
+                }
+                updated |= ImGui::SliderFloat("Air Density", &cannon.drag.airDensity, 0.f, 2.f, "%.3f kg/m3");
+
+                bool windEnabled = cannon.drag.wind != nullptr;
+                if (ImGui::Checkbox("Wind", &windEnabled))
+                {
+                    cannon.drag.wind = windEnabled ? &wind : nullptr;
+                    updated = true;
+                }
+                if (windEnabled)
+                    updated |= ImGui::SliderFloat("Wind Strength", &cannon.drag.windScale, 0.f, 3.f, "%.2f x");
+            }
+
+            // Derived launch values are recomputed on next use
+            if (updated)
+                InvalidateLaunchState(cannon);
         }
 
         ImGui::Text("Acceleration: x = %.2f y = %.2f\nVelocity:x = %.2f y = %.2f (%.2f m/s)\nPosition: x = %.2f y = %.2f",
@@ -220,8 +527,95 @@ void CannonRenderer::DrawImgui(Cannon& cannon, bool &updated)
     ImGui::End();
 }
 
+void CannonRenderer::DrawSalvoImgui(SalvoSettings& salvo, int rounds, bool& fire)
+{
+    PROFILE_FUNCTION();
+    if (ImGui::Begin("Salvo", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::Checkbox("Enabled", &salvo.enabled);
+        if (salvo.enabled)
+        {
+            fire = ImGui::Button("Fire Salvo");
+            ImGui::SameLine();
+            ImGui::Checkbox("Auto Fire", &salvo.autoFire);
+            ImGui::SliderInt("Cannons", &salvo.cannons, 1, 500);
+            ImGui::SliderFloat("Spacing", &salvo.spacing, 0.5f, 10.f, "%.1f m");
+            ImGui::SliderFloat("Fire Rate", &salvo.fireRate, 0.1f, 20.f, "%.1f /s");
+            ImGui::Text("Rounds in flight: %d / %d", rounds, SALVO_POOL_CAPACITY);
+        }
+    }
+
+    ImGui::End();
+}
+
+static bool PerturbationEdit(const char* label, Perturbation& perturbation, float max, const char* format)
+{
+    ImGui::PushID(label);
+    int distribution = (int)perturbation.distribution;
+    ImGui::SetNextItemWidth(90.f);
+    bool changed = ImGui::Combo("##distribution", &distribution, "None\0Normal\0Uniform\0");
+    perturbation.distribution = (Distribution)distribution;
+    ImGui::SameLine();
+    changed |= ImGui::SliderFloat(label, &perturbation.spread, 0.f, max, format);
+    ImGui::PopID();
+    return changed;
+}
+
+// Both 95% intervals of the mean impact within the target
+static bool TargetReached(const MonteCarloSettings& monteCarlo, const DispersionStats& stats)
+{
+    float2 mean, deviation;
+    if (monteCarlo.targetError <= 0.f || !DispersionConfidence(stats, mean, deviation))
+        return false;
+    return mean.x <= monteCarlo.targetError && mean.y <= monteCarlo.targetError;
+}
+
+void CannonRenderer::DrawMonteCarloImgui(MonteCarloSettings& monteCarlo, const DispersionStats& stats, float frameTime, bool& restart)
+{
+    PROFILE_FUNCTION();
+    if (ImGui::Begin("Monte Carlo", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        restart |= ImGui::Checkbox("Enabled", &monteCarlo.enabled);
+        if (monteCarlo.enabled)
+        {
+            DispersionSettings& dispersion = monteCarlo.dispersion;
+            restart |= PerturbationEdit("Angle", dispersion.angle, 0.05f, "%.4f rad");
+            restart |= PerturbationEdit("Initial Speed", dispersion.v0, 3.f, "%.2f m/s");
+            restart |= PerturbationEdit("Projectile Mass", dispersion.mass, 5.f, "%.2f kg");
+            restart |= PerturbationEdit("Wind (air drag)", dispersion.wind, 10.f, "%.1f m/s");
+            int sampling = (int)dispersion.sampling;
+            restart |= ImGui::Combo("Sampling", &sampling, "Random\0Sobol (scrambled)\0Halton (shifted)\0");
+            dispersion.sampling = (Sampling)sampling;
+            ImGui::SliderInt("Samples", &monteCarlo.samples, 1000, 100000000, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Frame Budget", &monteCarlo.frameBudget, 0.5f, 50.f, "%.1f ms", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderInt("Max Samples per Frame", &monteCarlo.samplesPerFrame, 1024, 1048576, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Target (95% of mean)", &monteCarlo.targetError, 0.f, 1.f, "%.5f m", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Ellipse", &monteCarlo.sigmas, 1.f, 3.f, "%.1f sigma");
+            restart |= ImGui::Button("Restart");
+
+            float xx, xy, yy;
+            DispersionCovariance(stats, xx, xy, yy);
+            float2 mean = DispersionMean(stats);
+            ImGui::Text("Samples: %lld / %d (%.2f ms/frame)%s", stats.samples, monteCarlo.samples, frameTime,
+                TargetReached(monteCarlo, stats) ? ", target reached" : "");
+            ImGui::Text("Left the barrel: %lld", stats.landed);
+            ImGui::Text("Mean impact: x = %.3f y = %.3f", mean.x, mean.y);
+            ImGui::Text("Std deviation: x = %.3f y = %.3f (corr. %.2f)", sqrtf(xx), sqrtf(yy), xx > 0.f && yy > 0.f ? xy / sqrtf(xx * yy) : 0.f);
+            ImGui::Text("CEP: %.3f m", DispersionCEP(stats));
+            float2 meanError, deviationError;
+            if (DispersionConfidence(stats, meanError, deviationError))
+            {
+                ImGui::Text("95%% interval of the mean: x +-%.5f y +-%.5f", meanError.x, meanError.y);
+                ImGui::Text("95%% interval of the std deviation: x +-%.5f y +-%.5f", deviationError.x, deviationError.y);
+            }
+        }
+    }
+
+    ImGui::End();
+}
+
 CannonGame::CannonGame(CannonRenderer& renderer)
-    : renderer(renderer)
+    : rounds(SALVO_POOL_CAPACITY), batterySpacing(0.f), salvoAccumulator(0.f), monteCarloTime(0.f), sampleCost(0.0), dispersionStale(true), renderer(renderer)
 {
     cannon.p0.x = -15.f;
     cannon.p0.y = 1.f;
@@ -231,48 +625,256 @@ CannonGame::CannonGame(CannonRenderer& renderer)
     cannon.v0         = 30.f,
     cannon.M          = 100.f,
     cannon.projectile = { false, 30.f, cannon.p0, { 0.f, 0.f }, { 0.f, 0.f } };
-    prevTime          = 0;
+    cannon.launch     = {};
+    cannon.drag       = { false, 0.47f, 0.028f, 1.225f, nullptr, 1.f };
     update            = true;
     time              = 0;
+    previousPosition       = cannon.p0;
+    previousCannonPosition = cannon.p0;
     collision = false;
+
+    ResetDispersion(dispersion, cannon.p0);
+
+    if (!wind.Load(WIND_FIELD_FILE))
+        wind.Generate(WindSettings(), { WIND_FIELD_MIN_X, GROUND_HEIGHT }, { WIND_FIELD_MAX_X, WIND_FIELD_MAX_Y }, WIND_FIELD_CELL);
+}
+
+void CannonGame::Launch()
+{
+    if (cannon.projectile.launched)
+        return;
+
+    update = true;
+    cannon.projectile.launched = true;
+    cannon.projectile.position = cannon.p0;
+}
+
+void CannonGame::EnableWind()
+{
+    if (cannon.projectile.launched)
+        return;
+
+    cannon.drag.enabled = true;
+    cannon.drag.wind = &wind;
+    InvalidateLaunchState(cannon);
+    update = true;
+}
+
+void CannonGame::FireSalvo()
+{
+    // Rounds are dropped once the pool is full
+    // The rounds keep the drag and wind of the cannon they were fired with
+    float drag = DragModel(cannon.drag, cannon.projectile.mass).k;
+    float windScale = cannon.drag.wind != nullptr ? cannon.drag.windScale : 0.f;
+    for (const Trajectory& shot : battery)
+        rounds.Spawn(shot, drag, windScale);
+}
+
+void CannonGame::UpdateSalvo(float deltaTime, bool fire)
+{
+    PROFILE_FUNCTION();
+    if (!salvo.enabled)
+    {
+        rounds.Clear();
+        salvoClock.Reset();
+        salvoAccumulator = 0.f;
+        return;
+    }
+
+    // Battery cannons share the settings of the main one, behind it along x
+    if (update || (int)battery.size() != salvo.cannons || batterySpacing != salvo.spacing)
+    {
+        battery.resize(salvo.cannons);
+        batterySpacing = salvo.spacing;
+        Cannon shot = cannon;
+        for (int i = 0; i < salvo.cannons; i++)
+        {
+            shot.p0.x = cannon.p0.x - i * salvo.spacing;
+            battery[i] = SolveTrajectory(shot);
+        }
+    }
+
+    if (fire)
+        FireSalvo();
+
+    if (rounds.Count() == 0 && !salvo.autoFire)
+    {
+        salvoClock.Reset();
+        return;
+    }
+
+    salvoClock.SetTickRate(renderer.tickRate);
+    int ticks = salvoClock.Advance(deltaTime * renderer.timeScale);
+    for (int i = 0; i < ticks; i++)
+    {
+        if (salvo.autoFire)
+        {
+            salvoAccumulator += salvoClock.TickTime() * salvo.fireRate;
+            for (; salvoAccumulator >= 1.f; salvoAccumulator -= 1.f)
+                FireSalvo();
+        }
+        rounds.Step(salvoClock.TickTime(), &wind);
+    }
+}
+
+void CannonGame::UpdateMonteCarlo(bool restart)
+{
+    PROFILE_FUNCTION();
+    monteCarloTime = 0.f;
+    dispersionStale |= restart;
+    if (!monteCarlo.enabled)
+        return;
+
+    // Statistics of the nominal shot: around its impact, with or without drag
+    // The drag impact is the one of the preview, no sample is taken until the worker publishes it
+    if (dispersionStale)
+    {
+        if (cannon.drag.enabled && preview.IsPending())
+            return;
+        float2 aim = cannon.drag.enabled ? preview.Current().path.result.impact : GetLaunchState(cannon).trajectory.impact;
+        ResetDispersion(dispersion, aim);
+        dispersionStale = false;
+        // A drag shot costs ~20x a vacuum one, measure again
+        sampleCost = 0.0;
+    }
+
+    long long remaining = monteCarlo.samples - dispersion.samples;
+    if (remaining <= 0 || TargetReached(monteCarlo, dispersion))
+        return;
+
+    // The batch runs on the job system while the main thread waits for it: it fits the frame budget at the cost
+    // of the last ones, the first batch after a restart is the smallest one
+    int count = MONTE_CARLO_MIN_BATCH;
+    if (sampleCost > 0.0)
+        count = (int)(monteCarlo.frameBudget * 1e6 / sampleCost) / MONTE_CARLO_MIN_BATCH * MONTE_CARLO_MIN_BATCH;
+    count = count < monteCarlo.samplesPerFrame ? count : monteCarlo.samplesPerFrame;
+    count = count > MONTE_CARLO_MIN_BATCH ? count : MONTE_CARLO_MIN_BATCH;
+    count = remaining < count ? (int)remaining : count;
+
+    uint64_t start = Profiler::Now();
+    RunDispersion(jobs, cannon, monteCarlo.dispersion, dispersion.samples, count, dispersion);
+    uint64_t elapsed = Profiler::Now() - start;
+    monteCarloTime = elapsed / 1e6f;
+
+    // Smoothed, one slow frame (preview build, page faults) doesn't shrink the next batches to the minimum
+    double cost = (double)elapsed / count;
+    sampleCost = sampleCost > 0.0 ? 0.5 * (sampleCost + cost) : cost;
 }
 
 void CannonGame::UpdateAndDraw(const float& deltaTime)
 {
+    PROFILE_FUNCTION();
     Projectile* p = &cannon.projectile;
 
     renderer.PreUpdate();
-    renderer.DrawImgui(cannon, update);
+    renderer.DrawImgui(cannon, wind, update);
+    bool fire = false;
+    renderer.DrawSalvoImgui(salvo, rounds.Count(), fire);
+    bool restart = false;
+    renderer.DrawMonteCarloImgui(monteCarlo, dispersion, monteCarloTime, restart);
 
-    if (p->launched)
-    {
-        // we use a temporary variable to save current position
-        float2 previousPosition = p->position;
+    // Only solved again after a parameter changed, the Launch button alone keeps the launch state
+    bool launchChanged = !cannon.launch.valid;
+    const Trajectory& trajectory = GetLaunchState(cannon).trajectory;
 
-        //If we haven't applied the collision
-        
-        //We get the position of the projectile in this moment
-        UpdateProjectile(cannon, p->position, prevTime, time);
+    // The preview is rebuilt in the background, keep drawing the last one meanwhile
+    if (update)
+        preview.Request(cannon);
+    preview.Poll();
 
-        //We increase the absolute time by the instant deltaTime
-        time += deltaTime * renderer.timeScale;
+    // With drag the shot follows the integrated path of the preview, nothing is integrated on this thread
+    bool drag = cannon.drag.enabled;
+    bool flightReady = !drag || !preview.IsPending();
+    const FlightPath& flight = preview.Current().path;
+    float impactTime = drag ? flight.result.flightTime : trajectory.impactTime;
 
-        // then we subtract the previous position from the current one to get the deltaSpeed at this moment
-        p->dSpeed = p->position - previousPosition;
+    if (p->launched)
+    {
+        clock.SetTickRate(renderer.tickRate);
+        int ticks = clock.Advance(deltaTime * renderer.timeScale);
+        // Launched right after a change: the shot waits at the breech for its path, a few milliseconds
+        if (!flightReady)
+        {
+            ticks = 0;
+            clock.Reset();
+        }
+        uint64_t simulationStart = Profiler::Now();
 
-        //we get the speed magnitude at this moment
-        p->speedMagnitude = length(p->dSpeed);
+        // The simulation only advances by whole ticks
+        for (int i = 0; i < ticks && p->launched; i++)
+        {
+            // we use a temporary variable to save current position
+            previousPosition = p->position;
+            previousCannonPosition = cannon.position;
+
+            //We increase the absolute time by one tick
+            time += clock.TickTime();
+
+            //We get the position of the projectile in this moment
+            if (drag)
+            {
+                // The barrel phase keeps its closed form acceleration
+                BodyState state = { FlightPathPosition(flight, time), FlightPathVelocity(flight, time) };
+                p->position     = state.position;
+                p->speed        = state.velocity;
+                p->acceleration = time < trajectory.exitTime ? TrajectoryAcceleration(trajectory, time)
+                    : DragModel(cannon.drag, p->mass)(time, state);
+            }
+            else
+            {
+                p->position     = TrajectoryPosition(trajectory, time);
+                p->speed        = TrajectorySpeed(trajectory, time);
+                p->acceleration = TrajectoryAcceleration(trajectory, time);
+            }
+            cannon.position = cannon.p0 + trajectory.recoilSpeed * fminf(time, impactTime);
+
+            //The projectile stops exactly on its impact point
+            if (time >= impactTime)
+                p->launched = false;
+
+            // then we subtract the previous position from the current one to get the deltaSpeed at this moment
+            p->dSpeed = p->position - previousPosition;
+
+            //we get the speed magnitude at this moment
+            p->speedMagnitude = length(p->dSpeed);
+        }
+
+        simulationTime = (Profiler::Now() - simulationStart) / 1e6f;
     }
     else
     {
         //We reset the time
-        prevTime = 0;
         time = 0;
         cannon.position = cannon.p0;
+        previousPosition = cannon.p0;
+        previousCannonPosition = cannon.p0;
+        clock.Reset();
         collision = false;
+        simulationTime = 0.f;
+    }
+
+    UpdateMonteCarlo(restart || launchChanged);
+
+    uint64_t salvoStart = Profiler::Now();
+    UpdateSalvo(deltaTime, fire);
+    simulationTime += (Profiler::Now() - salvoStart) / 1e6f;
+
+    // Draw the state between the last two ticks
+    Cannon view = cannon;
+    if (p->launched)
+    {
+        view.position = lerp(previousCannonPosition, cannon.position, clock.Alpha());
+        view.projectile.position = lerp(previousPosition, p->position, clock.Alpha());
     }
 
+    if (cannon.drag.enabled && cannon.drag.wind != nullptr)
+        renderer.DrawWind(*cannon.drag.wind, cannon.drag.windScale);
     renderer.DrawGround();
-    renderer.DrawCannon(cannon);
-    renderer.DrawProjectileMotion(cannon, update);
-}
\ No newline at end of file
+    renderer.DrawCannon(view);
+    renderer.DrawProjectileMotion(view, preview.Current());
+    renderer.DrawRounds(rounds, (salvoClock.Alpha() - 1.f) * salvoClock.TickTime());
+    if (monteCarlo.enabled)
+        renderer.DrawDispersion(dispersion, monteCarlo.sigmas);
+
+    update = false;
+}
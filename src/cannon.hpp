@@ -1,23 +1,48 @@
 #pragma once
 
 #include <imgui.h>
-#include <vector>
 
+#include "dispersion.hpp"
+#include "draw_cache.hpp"
+#include "flight.hpp"
+#include "preview_worker.hpp"
+#include "projectile_pool.hpp"
+#include "sim_clock.hpp"
+#include "simulation.hpp"
 #include "types.hpp"
+#include "wind_field.hpp"
 
-struct Projectile
+// Rounds the pool of the salvo mode can hold: 500 cannons with 64 rounds each in flight
+#define SALVO_POOL_CAPACITY 32768
+
+// World span of the wind field, enough for the largest battery behind the cannon and its longest shots
+#define WIND_FIELD_MIN_X -5100.f
+#define WIND_FIELD_MAX_X 1000.f
+#define WIND_FIELD_MAX_Y 500.f
+#define WIND_FIELD_CELL 5.f
+// Loaded instead of the procedural field when found in the working directory
+#define WIND_FIELD_FILE "wind.txt"
+
+// Battery of cannons sharing the settings of the main one, lined up behind it
+struct SalvoSettings
 {
-    bool launched;
-    float mass;
-    float2 position, speed, acceleration, dSpeed;
-    float speedMagnitude;
+    bool enabled = false;
+    int cannons = 100;
+    float spacing = 2.f;  // Meters between two cannons
+    bool autoFire = false;
+    float fireRate = 2.f; // Salvos per second in auto fire
 };
 
-struct Cannon
+// Monte Carlo dispersion of the main cannon, accumulated a few samples per frame until the target
+struct MonteCarloSettings
 {
-    float2 p0, position;
-    float angle, v0, L, M;
-    Projectile projectile;
+    bool enabled = false;
+    int samples = 1000000;
+    float frameBudget = 4.f;     // Time given to the samples each frame (ms), the batch is sized from the measured cost of a sample
+    int samplesPerFrame = 65536; // Upper bound of a batch
+    float targetError = 0.f; // Stops early once the 95% intervals of the mean impact are this narrow (m), 0 runs every sample
+    float sigmas = 2.f; // Size of the drawn ellipse in standard deviations
+    DispersionSettings dispersion;
 };
 
 class CannonRenderer
@@ -31,36 +56,130 @@ public:
     ImDrawList* dl;
     ImGuiIO* io;
 
+    // Camera: world point drawn at the view anchor (horizontal center, 3/4 of the height) and meters across the display
+    float2 cameraPosition = { 0.f, 0.f };
+    float viewWidth = 50.f;
+    void UpdateCamera(); // Left/middle drag pans, mouse wheel zooms around the cursor
+    void ResetCamera();
+
     // World coordinates conversion (world is expressed in meters)
     float2 worldOrigin; // Origin in pixels
     float2 worldScale;  // Scale relative to pixels
+
+    // Visible world rectangle, anything outside is culled
+    float2 viewMin;
+    float2 viewMax;
+    bool IsVisible(float2 min, float2 max) const;
     float2 ToPixels(float2 coordinatesInMeters);
     float2 ToWorld(float2 coordinatesInPixels);
+    // Whole point arrays, one pass of the affine transform
+    void ToPixels(const float2* coordinatesInMeters, ImVec2* pixels, int count);
 
     void DrawGround();
     void DrawCannon(const Cannon& cannon);
-    void DrawProjectileMotion(const Cannon& cannon, bool update);
+    void DrawTrajectory(const Trajectory& trajectory);
+    void DrawFlightPath(const FlightPath& path);
+    void DrawProjectileMotion(const Cannon& cannon, const PreviewCurve& preview);
+    // Live rounds of the pool, drawn timeOffset seconds away from their simulated time
+    void DrawRounds(const ProjectilePool& pool, float timeOffset);
+    // Arrows on a screen grid, scaled like the wind the projectiles feel
+    void DrawWind(const WindField& wind, float windScale);
+    // Covariance ellipse around the mean impact, CEP circle around the aim point
+    void DrawDispersion(const DispersionStats& stats, float sigmas);
 
-    void DrawImgui(Cannon& cannon, bool &update);
+    void DrawImgui(Cannon& cannon, const WindField& wind, bool &update);
+    void DrawSalvoImgui(SalvoSettings& salvo, int rounds, bool& fire);
+    void DrawMonteCarloImgui(MonteCarloSettings& monteCarlo, const DispersionStats& stats, float frameTime, bool& restart);
 
-    std::vector<float2> curvePoints;
+    // Max distance in pixels between a trajectory and its tessellation
+    float curveTolerance = 0.25f;
 
     float timeScale = 1.f;
+    float tickRate = 120.f; // Simulation ticks per second
+
+    // Replay the recorded ground, cannon and preview geometry instead of emitting it again
+    bool useDrawCache = true;
+    void InvalidateDrawCache();
+
+private:
+    // Draws through the cache: records draw() when the layer is dirty, then copies it into dl
+    template<typename F>
+    void DrawCached(DrawCache& cache, F draw);
+
+    // Last trajectory tessellated in world space, camera changes only transform the points again
+    Trajectory tessellated;
+    float tessellatedScale; // Level of detail: power of two pixels per meter the points were tessellated for
+    std::vector<float2> trajectoryPoints;
+    std::vector<ImVec2> trajectoryPixels;
+    void DrawWorldPolyline(const std::vector<float2>& points);
+
+    // Arrow positions and wind of DrawWind
+    std::vector<float> arrowX, arrowY, arrowU, arrowV;
+    // Positions of the pooled rounds, evaluated in one batch
+    std::vector<float> roundX, roundY;
+
+    ImDrawList recorder; // Target of dl while a layer is recorded
+    float2 drawnOrigin;  // World to pixels transform the layers were recorded with
+    float2 drawnScale;
+    DrawCache groundCache;
+    DrawCache cannonCache;
+    DrawCache trajectoryCache;
+    DrawCache projectileCache;
+    DrawCache windCache;
 };
 
 class CannonGame
 {
     bool update;
     float time;
-    float prevTime;
     bool collision;
+    FixedStepClock clock;
+    float2 previousPosition;       // Projectile position at the previous tick
+    float2 previousCannonPosition; // Cannon position at the previous tick
+    WindField wind; // Shared with the preview worker, never modified after the constructor
+    PreviewWorker preview;
+
+    // Salvo mode, the rounds are stepped by their own clock
+    SalvoSettings salvo;
+    ProjectilePool rounds;
+    FixedStepClock salvoClock;
+    std::vector<Trajectory> battery; // Shot of each battery cannon
+    float batterySpacing;            // Spacing the battery was solved with
+    float salvoAccumulator;          // Fraction of the next auto fire salvo
+
+    // Monte Carlo mode, restarted by any change of the cannon
+    MonteCarloSettings monteCarlo;
+    DispersionStats dispersion;
+    JobSystem jobs;
+    float monteCarloTime; // Time spent on the samples of the last frame (ms)
+    double sampleCost;    // Measured cost of a sample (ns), 0 until the first batch after a restart
+    bool dispersionStale; // Restart requested, done once the nominal impact is known
 public:
     CannonGame(CannonRenderer& renderer);
     ~CannonGame() = default;
 
     void UpdateAndDraw(const float& deltaTime);
 
+    // Same as the "Launch" button, ignored while the projectile is flying
+    void Launch();
+
+    // Air drag and wind on the cannon and the salvo (headless runs)
+    void EnableWind();
+
+    SalvoSettings& Salvo() { return salvo; }
+    MonteCarloSettings& MonteCarlo() { return monteCarlo; }
+    long long DispersionSamples() const { return dispersion.samples; }
+    const DispersionStats& Dispersion() const { return dispersion; }
+    int SalvoRounds() const { return rounds.Count(); }
+
+    float simulationTime = 0.f; // Time spent in the simulation ticks of the last frame (ms)
+    float PreviewBuildTime() const { return preview.LastBuildTime(); }
+
 private:
+    void UpdateSalvo(float deltaTime, bool fire);
+    void FireSalvo();
+    void UpdateMonteCarlo(bool restart);
+
     CannonRenderer& renderer;
     Cannon cannon;
 };
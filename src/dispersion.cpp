@@ -0,0 +1,405 @@
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "calc.hpp"
+#include "dispersion.hpp"
+#include "flight.hpp"
+#include "profiler.hpp"
+#include "qmc.hpp"
+#include "random.hpp"
+
+void ResetDispersion(DispersionStats& stats, float2 aim)
+{
+    memset(&stats, 0, sizeof(DispersionStats));
+    stats.aim = aim;
+}
+
+static int DistanceBin(float distance)
+{
+    static const float binsPerLog = DISPERSION_BINS / logf(DISPERSION_MAX_DISTANCE / DISPERSION_MIN_DISTANCE);
+    if (distance <= DISPERSION_MIN_DISTANCE)
+        return 0;
+    int bin = (int)(logf(distance / DISPERSION_MIN_DISTANCE) * binsPerLog);
+    return bin < DISPERSION_BINS ? bin : DISPERSION_BINS - 1;
+}
+
+static void AddReplicate(DispersionReplicate& replicate, float2 impact, float2 aim)
+{
+    double dx = impact.x - aim.x;
+    double dy = impact.y - aim.y;
+    replicate.landed++;
+    replicate.sumX += dx;
+    replicate.sumY += dy;
+    replicate.sumXX += dx * dx;
+    replicate.sumYY += dy * dy;
+}
+
+void AddImpact(DispersionStats& stats, float2 impact, uint64_t index)
+{
+    AddReplicate(stats.replicates[index % DISPERSION_REPLICATES], impact, stats.aim);
+    stats.landed++;
+    double dx = impact.x - stats.meanX;
+    double dy = impact.y - stats.meanY;
+    stats.meanX += dx / stats.landed;
+    stats.meanY += dy / stats.landed;
+    stats.m2xx += dx * (impact.x - stats.meanX);
+    stats.m2xy += dx * (impact.y - stats.meanY);
+    stats.m2yy += dy * (impact.y - stats.meanY);
+    stats.histogram[DistanceBin(length(impact - stats.aim))]++;
+}
+
+// Chan et al. pairwise update of the moments with a group of landed impacts
+static void MergeMoments(DispersionStats& stats, long long landed, double meanX, double meanY, double m2xx, double m2xy, double m2yy)
+{
+    if (landed == 0)
+        return;
+
+    double n = (double)(stats.landed + landed);
+    double weight = (double)stats.landed * landed / n;
+    double dx = meanX - stats.meanX;
+    double dy = meanY - stats.meanY;
+    stats.meanX += dx * landed / n;
+    stats.meanY += dy * landed / n;
+    stats.m2xx += m2xx + dx * dx * weight;
+    stats.m2xy += m2xy + dx * dy * weight;
+    stats.m2yy += m2yy + dy * dy * weight;
+    stats.landed += landed;
+}
+
+void MergeDispersion(DispersionStats& stats, const DispersionStats& other)
+{
+    stats.samples += other.samples;
+    for (int i = 0; i < DISPERSION_BINS; i++)
+        stats.histogram[i] += other.histogram[i];
+    for (int r = 0; r < DISPERSION_REPLICATES; r++)
+    {
+        DispersionReplicate& replicate = stats.replicates[r];
+        replicate.landed += other.replicates[r].landed;
+        replicate.sumX += other.replicates[r].sumX;
+        replicate.sumY += other.replicates[r].sumY;
+        replicate.sumXX += other.replicates[r].sumXX;
+        replicate.sumYY += other.replicates[r].sumYY;
+    }
+    MergeMoments(stats, other.landed, other.meanX, other.meanY, other.m2xx, other.m2xy, other.m2yy);
+}
+
+// Moments of a batch in two passes over its results (no division per sample), then merged
+static void AddBatch(DispersionStats& stats, const ShotResult* results, uint64_t first, int count)
+{
+    int landed = 0;
+    double sumX = 0.0, sumY = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!results[i].landed)
+            continue;
+        landed++;
+        sumX += results[i].impact.x;
+        sumY += results[i].impact.y;
+        stats.histogram[DistanceBin(length(results[i].impact - stats.aim))]++;
+        AddReplicate(stats.replicates[(first + i) % DISPERSION_REPLICATES], results[i].impact, stats.aim);
+    }
+    if (landed == 0)
+        return;
+
+    double meanX = sumX / landed;
+    double meanY = sumY / landed;
+    double m2xx = 0.0, m2xy = 0.0, m2yy = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!results[i].landed)
+            continue;
+        double dx = results[i].impact.x - meanX;
+        double dy = results[i].impact.y - meanY;
+        m2xx += dx * dx;
+        m2xy += dx * dy;
+        m2yy += dy * dy;
+    }
+    MergeMoments(stats, landed, meanX, meanY, m2xx, m2xy, m2yy);
+}
+
+float2 DispersionMean(const DispersionStats& stats)
+{
+    return { (float)stats.meanX, (float)stats.meanY };
+}
+
+void DispersionCovariance(const DispersionStats& stats, float& xx, float& xy, float& yy)
+{
+    double n = stats.landed > 1 ? (double)(stats.landed - 1) : 1.0;
+    xx = (float)(stats.m2xx / n);
+    xy = (float)(stats.m2xy / n);
+    yy = (float)(stats.m2yy / n);
+}
+
+float DispersionCEP(const DispersionStats& stats)
+{
+    if (stats.landed == 0)
+        return 0.f;
+
+    // Bin holding the median distance, interpolated geometrically inside it
+    double half = 0.5 * stats.landed;
+    double cumulated = 0.0;
+    float ratio = logf(DISPERSION_MAX_DISTANCE / DISPERSION_MIN_DISTANCE) / DISPERSION_BINS;
+    for (int i = 0; i < DISPERSION_BINS; i++)
+    {
+        if (cumulated + stats.histogram[i] >= half)
+        {
+            float t = stats.histogram[i] > 0 ? (float)((half - cumulated) / stats.histogram[i]) : 0.f;
+            return DISPERSION_MIN_DISTANCE * expf((i + t) * ratio);
+        }
+        cumulated += stats.histogram[i];
+    }
+    return DISPERSION_MAX_DISTANCE;
+}
+
+// Student t half width of the mean of the replicate estimates
+static float HalfWidth(const double* estimates)
+{
+    double mean = 0.0;
+    for (int r = 0; r < DISPERSION_REPLICATES; r++)
+        mean += estimates[r];
+    mean /= DISPERSION_REPLICATES;
+    double squares = 0.0;
+    for (int r = 0; r < DISPERSION_REPLICATES; r++)
+        squares += (estimates[r] - mean) * (estimates[r] - mean);
+    return DISPERSION_T95 * (float)sqrt(squares / ((DISPERSION_REPLICATES - 1) * DISPERSION_REPLICATES));
+}
+
+bool DispersionConfidence(const DispersionStats& stats, float2& mean, float2& deviation)
+{
+    double meanX[DISPERSION_REPLICATES], meanY[DISPERSION_REPLICATES];
+    double deviationX[DISPERSION_REPLICATES], deviationY[DISPERSION_REPLICATES];
+    for (int r = 0; r < DISPERSION_REPLICATES; r++)
+    {
+        const DispersionReplicate& replicate = stats.replicates[r];
+        if (replicate.landed < 2)
+            return false;
+        double n = (double)replicate.landed;
+        meanX[r] = replicate.sumX / n;
+        meanY[r] = replicate.sumY / n;
+        deviationX[r] = sqrt(fmax(replicate.sumXX - n * meanX[r] * meanX[r], 0.0) / (n - 1.0));
+        deviationY[r] = sqrt(fmax(replicate.sumYY - n * meanY[r] * meanY[r], 0.0) / (n - 1.0));
+    }
+
+    mean = { HalfWidth(meanX), HalfWidth(meanY) };
+    deviation = { HalfWidth(deviationX), HalfWidth(deviationY) };
+    return true;
+}
+
+// Draw number of each parameter: a sample is a counter of the generator, not a position in a stream
+enum DispersionDraw
+{
+    DRAW_ANGLE,
+    DRAW_V0,
+    DRAW_MASS,
+    DRAW_WIND,
+    DRAW_COUNT,
+};
+
+// Scrambling seeds (Sobol) or shifts (Halton) of each replicate and parameter
+struct QuasiRandomization
+{
+    uint32_t seeds[DISPERSION_REPLICATES][DRAW_COUNT];
+
+    QuasiRandomization(uint64_t seed)
+    {
+        for (int r = 0; r < DISPERSION_REPLICATES; r++)
+        {
+            for (int draw = 0; draw < DRAW_COUNT; draw++)
+                seeds[r][draw] = RandomBits(seed, r, draw);
+        }
+    }
+};
+
+// Parameter draw of a sample: a coordinate of point index / DISPERSION_REPLICATES of its replicate
+static float PerturbQuasi(const Perturbation& perturbation, Sampling sampling, const QuasiRandomization& randomization,
+    uint64_t index, uint32_t draw)
+{
+    if (perturbation.distribution == Distribution::None)
+        return 0.f;
+
+    uint32_t point = (uint32_t)(index / DISPERSION_REPLICATES);
+    uint32_t seed = randomization.seeds[index % DISPERSION_REPLICATES][draw];
+    uint32_t bits = sampling == Sampling::Sobol ? OwenScramble(SobolBits(point, draw), seed) : HaltonBits(point, draw) + seed;
+    float u = BitsToUniform(bits);
+    if (perturbation.distribution == Distribution::Normal)
+        return perturbation.spread * InverseNormal(u);
+    return perturbation.spread * (2.f * u - 1.f);
+}
+
+static float Perturb(const Perturbation& perturbation, uint64_t seed, uint64_t index, uint32_t draw)
+{
+    switch (perturbation.distribution)
+    {
+    case Distribution::Normal:
+        return perturbation.spread * RandomNormal(seed, index, draw);
+    case Distribution::Uniform:
+        return perturbation.spread * (2.f * RandomUniform(seed, index, draw) - 1.f);
+    default:
+        return 0.f;
+    }
+}
+
+// Same offsets as Perturb (PerturbQuasi) for count consecutive samples, random ones 8 or 16 at a time
+static void PerturbBatch(const Perturbation& perturbation, const DispersionSettings& settings, const QuasiRandomization& randomization,
+    uint64_t first, uint32_t draw, float* out, int count)
+{
+    uint64_t seed = settings.seed;
+    if (settings.sampling != Sampling::Random)
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = PerturbQuasi(perturbation, settings.sampling, randomization, first + i, draw);
+        return;
+    }
+
+    switch (perturbation.distribution)
+    {
+    case Distribution::Normal:
+        RandomNormals(seed, first, draw, out, count);
+        for (int i = 0; i < count; i++)
+            out[i] = perturbation.spread * out[i];
+        break;
+    case Distribution::Uniform:
+        RandomUniforms(seed, first, draw, out, count);
+        for (int i = 0; i < count; i++)
+            out[i] = perturbation.spread * (2.f * out[i] - 1.f);
+        break;
+    default:
+        memset(out, 0, count * sizeof(float));
+        break;
+    }
+}
+
+static Cannon ApplyPerturbation(const Cannon& cannon, float angle, float v0, float mass)
+{
+    Cannon sample = cannon;
+    sample.angle += angle;
+    sample.v0 = fmaxf(sample.v0 + v0, 0.f);
+    sample.projectile.mass = fmaxf(sample.projectile.mass + mass, 1e-3f);
+    sample.launch.valid = false;
+    return sample;
+}
+
+Cannon DispersionSample(const Cannon& cannon, const DispersionSettings& settings, uint64_t index, float& wind)
+{
+    if (settings.sampling != Sampling::Random)
+    {
+        QuasiRandomization randomization(settings.seed);
+        float angle = PerturbQuasi(settings.angle, settings.sampling, randomization, index, DRAW_ANGLE);
+        float v0 = PerturbQuasi(settings.v0, settings.sampling, randomization, index, DRAW_V0);
+        float mass = PerturbQuasi(settings.mass, settings.sampling, randomization, index, DRAW_MASS);
+        wind = cannon.drag.enabled ? PerturbQuasi(settings.wind, settings.sampling, randomization, index, DRAW_WIND) : 0.f;
+        return ApplyPerturbation(cannon, angle, v0, mass);
+    }
+
+    float angle = Perturb(settings.angle, settings.seed, index, DRAW_ANGLE);
+    float v0 = Perturb(settings.v0, settings.seed, index, DRAW_V0);
+    float mass = Perturb(settings.mass, settings.seed, index, DRAW_MASS);
+    wind = cannon.drag.enabled ? Perturb(settings.wind, settings.seed, index, DRAW_WIND) : 0.f;
+    return ApplyPerturbation(cannon, angle, v0, mass);
+}
+
+// DragModel of a batch of samples, each with its mass and steady wind: the wind field of a stage is sampled
+// at the positions of all the samples at once
+struct DispersionDragForce
+{
+    float* k;
+    const float* steadyWind;
+    const WindField* wind;
+    float windScale;
+    float* x;
+    float* y;
+    float* u;
+    float* v;
+
+    void operator()(const int* samples, const BodyState* states, float2* accelerations, int n) const
+    {
+        if (wind != nullptr)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                x[i] = states[i].position.x;
+                y[i] = states[i].position.y;
+            }
+            wind->Sample(x, y, u, v, n);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            float2 airSpeed = states[i].velocity - float2{ steadyWind[samples[i]], 0.f };
+            if (wind != nullptr)
+                airSpeed = airSpeed - float2{ u[i], v[i] } * windScale;
+            accelerations[i] = float2{ 0.f, -GRAVITY } - airSpeed * (k[samples[i]] * length(airSpeed));
+        }
+    }
+};
+
+// One block: batches of perturbed cannons through the physics kernel, reduced as they come
+static void RunBlock(const Cannon& cannon, const DispersionSettings& settings, const QuasiRandomization& randomization,
+    uint64_t first, int count, DispersionStats& stats)
+{
+    Cannon cannons[DISPERSION_BATCH];
+    ShotResult results[DISPERSION_BATCH];
+    float angles[DISPERSION_BATCH], v0s[DISPERSION_BATCH], masses[DISPERSION_BATCH], winds[DISPERSION_BATCH];
+    IntegratorSettings flightSettings = FlightIntegratorSettings();
+    Trajectory trajectories[DISPERSION_BATCH];
+    float k[DISPERSION_BATCH], x[DISPERSION_BATCH], y[DISPERSION_BATCH], u[DISPERSION_BATCH], v[DISPERSION_BATCH];
+    DispersionDragForce force = { k, winds, cannon.drag.wind, cannon.drag.windScale, x, y, u, v };
+    // Sized once per worker thread, blocks do not allocate
+    static thread_local DormandPrince45Batch flights;
+    if ((int)flights.bodies.size() < DISPERSION_BATCH)
+        flights.Resize(DISPERSION_BATCH);
+    for (int begin = 0; begin < count; begin += DISPERSION_BATCH)
+    {
+        int batch = count - begin < DISPERSION_BATCH ? count - begin : DISPERSION_BATCH;
+        // Parameter by parameter over the batch, the same numbers as DispersionSample
+        uint64_t batchFirst = first + begin;
+        PerturbBatch(settings.angle, settings, randomization, batchFirst, DRAW_ANGLE, angles, batch);
+        PerturbBatch(settings.v0, settings, randomization, batchFirst, DRAW_V0, v0s, batch);
+        PerturbBatch(settings.mass, settings, randomization, batchFirst, DRAW_MASS, masses, batch);
+        if (cannon.drag.enabled)
+            PerturbBatch(settings.wind, settings, randomization, batchFirst, DRAW_WIND, winds, batch);
+        for (int i = 0; i < batch; i++)
+            cannons[i] = ApplyPerturbation(cannon, angles[i], v0s[i], masses[i]);
+
+        if (cannon.drag.enabled)
+        {
+            // No closed form under drag: the shots are integrated together, without keeping their paths
+            for (int i = 0; i < batch; i++)
+            {
+                trajectories[i] = SolveTrajectory(cannons[i]);
+                force.k[i] = DragModel(cannons[i].drag, cannons[i].projectile.mass).k;
+            }
+            IntegrationStats integration;
+            IntegrateFlightBatch(force, trajectories, results, batch, flightSettings, flights, integration);
+        }
+        else
+        {
+            SimulateBatch(cannons, results, batch);
+        }
+
+        stats.samples += batch;
+        AddBatch(stats, results, batchFirst, batch);
+    }
+}
+
+void RunDispersion(JobSystem& jobs, const Cannon& cannon, const DispersionSettings& settings,
+    uint64_t first, int count, DispersionStats& stats)
+{
+    PROFILE_FUNCTION();
+    int blockCount = (count + DISPERSION_BLOCK - 1) / DISPERSION_BLOCK;
+    std::vector<DispersionStats> blocks(blockCount);
+    QuasiRandomization randomization(settings.seed);
+    jobs.ParallelFor(blockCount, 1, [&](int begin, int end)
+    {
+        for (int b = begin; b < end; b++)
+        {
+            int blockFirst = b * DISPERSION_BLOCK;
+            int size = count - blockFirst < DISPERSION_BLOCK ? count - blockFirst : DISPERSION_BLOCK;
+            ResetDispersion(blocks[b], stats.aim);
+            RunBlock(cannon, settings, randomization, first + blockFirst, size, blocks[b]);
+        }
+    });
+
+    for (const DispersionStats& block : blocks)
+        MergeDispersion(stats, block);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "job_system.hpp"
+#include "simulation.hpp"
+
+// Bins of the impact distance histogram, log spaced from DISPERSION_MIN_DISTANCE to DISPERSION_MAX_DISTANCE (3% wide)
+#define DISPERSION_BINS 512
+#define DISPERSION_MIN_DISTANCE 1e-3f
+#define DISPERSION_MAX_DISTANCE 1e4f
+// Samples reduced by one job, blocks are merged in order so the result doesn't depend on the threads
+#define DISPERSION_BLOCK 4096
+// Perturbed cannons handed to the physics kernel at once
+#define DISPERSION_BATCH 256
+// Independent randomizations of the point set, sample i belongs to replicate i % DISPERSION_REPLICATES
+// The spread of their estimates gives the confidence intervals (batch means for random sampling)
+#define DISPERSION_REPLICATES 16
+// Student t quantile for a two-sided 95% interval with DISPERSION_REPLICATES - 1 degrees of freedom
+#define DISPERSION_T95 2.131f
+
+enum class Distribution
+{
+    None,
+    Normal,  // spread is the standard deviation
+    Uniform, // spread is the half width
+};
+
+enum class Sampling
+{
+    Random, // Independent draws of the counter-based generator
+    Sobol,  // Owen-scrambled Sobol points, one scrambling per replicate
+    Halton, // Halton points, one random shift per replicate
+};
+
+// Random offset added to a parameter
+struct Perturbation
+{
+    Distribution distribution;
+    float spread;
+};
+
+struct DispersionSettings
+{
+    Perturbation angle = { Distribution::Normal, 0.002f }; // rad
+    Perturbation v0    = { Distribution::Normal, 0.2f };   // m/s
+    Perturbation mass  = { Distribution::Uniform, 0.5f };  // kg
+    Perturbation wind  = { Distribution::Normal, 1.f };    // m/s of steady horizontal wind, only felt through the air drag
+    Sampling sampling = Sampling::Sobol;
+    uint64_t seed = 1;
+};
+
+// Sums of the impacts of one replicate, relative to the aim point
+struct DispersionReplicate
+{
+    long long landed;
+    double sumX, sumY;
+    double sumXX, sumYY;
+};
+
+// Streaming reduction of the impact points: nothing is stored per sample
+struct DispersionStats
+{
+    long long samples;  // Simulated shots
+    long long landed;   // Shots that left the barrel, the only ones in the statistics
+    double meanX, meanY;
+    double m2xx, m2xy, m2yy; // Sums of the products of the deviations from the mean (Welford)
+    float2 aim;              // Nominal impact, center of the distance histogram
+    uint32_t histogram[DISPERSION_BINS];
+    DispersionReplicate replicates[DISPERSION_REPLICATES];
+};
+
+void ResetDispersion(DispersionStats& stats, float2 aim);
+// index is the sample index, it decides the replicate
+void AddImpact(DispersionStats& stats, float2 impact, uint64_t index);
+// Same result as adding the impacts of other one by one (up to rounding), both must share the aim point
+void MergeDispersion(DispersionStats& stats, const DispersionStats& other);
+
+float2 DispersionMean(const DispersionStats& stats);
+// Sample covariance of the impact points: xx, xy, yy
+void DispersionCovariance(const DispersionStats& stats, float& xx, float& xy, float& yy);
+// Circular error probable: radius around the aim point holding half of the impacts
+float DispersionCEP(const DispersionStats& stats);
+// Half widths of the 95% confidence intervals of the mean impact and of the standard deviations
+// False until every replicate has two landed shots
+bool DispersionConfidence(const DispersionStats& stats, float2& mean, float2& deviation);
+
+// Cannon of one sample, only depends on the settings seed and the sample index
+// wind receives the steady wind of the sample
+Cannon DispersionSample(const Cannon& cannon, const DispersionSettings& settings, uint64_t index, float& wind);
+
+// Simulates the samples [first, first + count) in parallel and adds them to stats
+void RunDispersion(JobSystem& jobs, const Cannon& cannon, const DispersionSettings& settings,
+    uint64_t first, int count, DispersionStats& stats);
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include "draw_cache.hpp"
+
+DrawCache::DrawCache()
+    : dirty(true), key(), keySize(0)
+{
+}
+
+void DrawCache::SetKey(const void* newKey, int size)
+{
+    IM_ASSERT(size <= DRAW_CACHE_KEY_SIZE);
+    if (size == keySize && memcmp(key, newKey, size) == 0)
+        return;
+
+    memcpy(key, newKey, size);
+    keySize = size;
+    dirty = true;
+}
+
+void DrawCache::Store(const ImDrawList& recorder)
+{
+    // A single command from vertex 0: the layers are far below the 16 bits index limit
+    IM_ASSERT(recorder.VtxBuffer.Size < (1 << 16));
+    // Copies keep the capacity: layers recorded every frame (cannon in flight) don't allocate
+    vertices.resize(recorder.VtxBuffer.Size);
+    indices.resize(recorder.IdxBuffer.Size);
+    memcpy(vertices.Data, recorder.VtxBuffer.Data, vertices.size_in_bytes());
+    memcpy(indices.Data, recorder.IdxBuffer.Data, indices.size_in_bytes());
+    dirty = false;
+}
+
+void DrawCache::Replay(ImDrawList* dl) const
+{
+    if (indices.Size == 0)
+        return;
+
+    dl->PrimReserve(indices.Size, vertices.Size);
+    ImDrawIdx base = (ImDrawIdx)dl->_VtxCurrentIdx;
+    memcpy(dl->_VtxWritePtr, vertices.Data, vertices.size_in_bytes());
+    for (int i = 0; i < indices.Size; i++)
+        dl->_IdxWritePtr[i] = (ImDrawIdx)(base + indices.Data[i]);
+
+    dl->_VtxWritePtr += vertices.Size;
+    dl->_IdxWritePtr += indices.Size;
+    dl->_VtxCurrentIdx += vertices.Size;
+}
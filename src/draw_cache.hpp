@@ -0,0 +1,33 @@
+#pragma once
+
+#include <imgui.h>
+
+// Largest key a cached layer can track (bytes)
+#define DRAW_CACHE_KEY_SIZE 64
+
+// Vertices and indices of a draw layer recorded once, then copied into a draw list every frame until it is dirty
+// Only valid for geometry drawn with the font atlas (white pixel UV) under the full screen clip rect
+class DrawCache
+{
+public:
+    DrawCache();
+
+    bool dirty;
+
+    // Marks the layer dirty when the inputs it was recorded from changed
+    void SetKey(const void* key, int size);
+
+    // Keeps the geometry emitted into a recorder list (see CannonRenderer::DrawCached)
+    void Store(const ImDrawList& recorder);
+
+    // Bulk copy into dl, indices rebased on its current vertex index
+    void Replay(ImDrawList* dl) const;
+
+    int VertexCount() const { return vertices.Size; }
+
+private:
+    ImVector<ImDrawVert> vertices;
+    ImVector<ImDrawIdx> indices;
+    unsigned char key[DRAW_CACHE_KEY_SIZE];
+    int keySize;
+};
@@ -0,0 +1,118 @@
+#include <math.h>
+#include <algorithm>
+
+#include "flight.hpp"
+#include "profiler.hpp"
+
+IntegratorSettings FlightIntegratorSettings()
+{
+    IntegratorSettings settings;
+    settings.step = 0.01f;
+    settings.tolerance = 1e-3f;
+    settings.minStep = 1e-4f;
+    settings.maxStep = 2.f;
+    settings.maxSteps = 4096;
+    return settings;
+}
+
+bool SolveFlightPath(const Cannon& cannon, FlightPath& path, const IntegratorSettings& settings, const std::atomic<bool>* cancel)
+{
+    PROFILE_FUNCTION();
+    Trajectory trajectory = SolveTrajectory(cannon);
+    path.times.clear();
+    path.states.clear();
+
+    // Barrel phase, uniformly decelerated: its end points are enough for the Hermite interpolation
+    path.times.push_back(0.f);
+    path.states.push_back({ trajectory.p0, trajectory.direction * trajectory.v0 });
+    if (!trajectory.exits)
+    {
+        path.times.push_back(trajectory.impactTime);
+        path.states.push_back({ trajectory.impact, trajectory.exitSpeed });
+        path.result = {};
+        path.result.flightTime = trajectory.impactTime;
+        path.result.impact = trajectory.impact;
+        path.result.recoil = trajectory.recoilSpeed * trajectory.impactTime;
+        path.stats = {};
+        return true;
+    }
+
+    // The exit state is the first sample of the observer
+    path.result = IntegrateFlight<DormandPrince45>(DragModel(cannon.drag, cannon.projectile.mass), trajectory, settings, path.stats,
+        [&](float t, const BodyState& state)
+        {
+            path.times.push_back(t);
+            path.states.push_back(state);
+        },
+        [cancel]() { return cancel != nullptr && cancel->load(std::memory_order_relaxed); });
+    return cancel == nullptr || !cancel->load(std::memory_order_relaxed);
+}
+
+// Sample interval holding time, s in [0, 1] inside it
+static int FindSegment(const FlightPath& path, float time, float& s)
+{
+    int last = (int)path.times.size() - 1;
+    if (last <= 0 || time <= path.times[0])
+    {
+        s = 0.f;
+        return 0;
+    }
+    if (time >= path.times[last])
+    {
+        s = 1.f;
+        return last - 1 > 0 ? last - 1 : 0;
+    }
+
+    int i = (int)(std::upper_bound(path.times.begin(), path.times.end(), time) - path.times.begin()) - 1;
+    float dt = path.times[i + 1] - path.times[i];
+    s = dt > 0.f ? (time - path.times[i]) / dt : 0.f;
+    return i;
+}
+
+float2 FlightPathPosition(const FlightPath& path, float time)
+{
+    if (path.states.size() < 2)
+        return path.states.empty() ? float2{ 0.f, 0.f } : path.states[0].position;
+
+    float s;
+    int i = FindSegment(path, time, s);
+    return HermitePosition(path.states[i], path.states[i + 1], path.times[i + 1] - path.times[i], s);
+}
+
+float2 FlightPathVelocity(const FlightPath& path, float time)
+{
+    if (path.states.size() < 2)
+        return path.states.empty() ? float2{ 0.f, 0.f } : path.states[0].velocity;
+
+    float s;
+    int i = FindSegment(path, time, s);
+    float dt = path.times[i + 1] - path.times[i];
+    if (dt <= 0.f)
+        return path.states[i].velocity;
+    return HermiteVelocity(path.states[i], path.states[i + 1], dt, s);
+}
+
+void TessellateFlightPath(const FlightPath& path, float tolerance, std::vector<float2>& points)
+{
+    points.clear();
+    if (path.states.empty())
+        return;
+
+    points.push_back(path.states[0].position);
+    for (size_t i = 0; i + 1 < path.states.size(); i++)
+    {
+        const BodyState& start = path.states[i];
+        const BodyState& end = path.states[i + 1];
+        float dt = path.times[i + 1] - path.times[i];
+
+        // Chord error of the quadratic through the end points and the midpoint, as in TessellateTrajectory
+        float2 middle = HermitePosition(start, end, dt, 0.5f);
+        float2 d = (start.position + end.position - middle * 2.f) * 2.f;
+        int segments = (int)ceilf(sqrtf(length(d) / (4.f * tolerance)));
+        if (segments < 1)
+            segments = 1;
+
+        for (int j = 1; j <= segments; j++)
+            points.push_back(HermitePosition(start, end, dt, (float)j / segments));
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "integrators.hpp"
+#include "simulation.hpp"
+
+// Shot integrated numerically (air drag), sampled at the accepted steps of the integrator
+// Samples start at the launch: the barrel phase keeps its closed form and is stored as its two end points
+struct FlightPath
+{
+    std::vector<float> times;
+    std::vector<BodyState> states;
+    ShotResult result;
+    IntegrationStats stats;
+};
+
+// Error controlled steps: the smooth middle of the flight takes a few long steps, the per shot cost stays
+// bounded by maxSteps at any range (the flight is cut there)
+IntegratorSettings FlightIntegratorSettings();
+
+// Integrates the shot with Dormand-Prince 45 and the drag model of the cannon
+// A raised cancel stops the integration at the next accepted step: returns false, the path is incomplete
+bool SolveFlightPath(const Cannon& cannon, FlightPath& path, const IntegratorSettings& settings = FlightIntegratorSettings(),
+    const std::atomic<bool>* cancel = nullptr);
+
+// State at a time since launch (clamped to the flight), cubic Hermite between the samples
+float2 FlightPathPosition(const FlightPath& path, float time);
+float2 FlightPathVelocity(const FlightPath& path, float time);
+
+// World space polyline of the flight, no point is further than tolerance (meters) from the interpolated path
+void TessellateFlightPath(const FlightPath& path, float tolerance, std::vector<float2>& points);
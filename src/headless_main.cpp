@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include <imgui.h>
+
+#include "app.hpp"
+#include "profiler.hpp"
+
+// operator new calls of every thread (ImGui allocates through its own functions, counted below)
+static std::atomic<long long> newAllocations(0);
+
+void* operator new(size_t size)
+{
+    newAllocations++;
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+// ImGui allocations only (IM_ALLOC: draw lists, windows, storage...)
+static long long imguiAllocations = 0;
+
+static void* CountingAlloc(size_t size, void*)
+{
+    imguiAllocations++;
+    return malloc(size);
+}
+
+static void CountingFree(void* ptr, void*)
+{
+    free(ptr);
+}
+
+struct HeadlessFrame
+{
+    float cpuMs;    // NewFrame to Render
+    float updateMs; // App::Update
+    float renderMs; // ImGui::Render
+    long long imguiAllocations;
+    long long newAllocations;
+    int vertices;
+    int indices;
+    int rounds;     // Salvo rounds in flight
+};
+
+template<typename T>
+static T Percentile(std::vector<T> values, float p)
+{
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5f);
+    return values[index];
+}
+
+// Runs App::Update on an ImGui context without window nor renderer backend
+// cannon_headless [--frames N] [--warmup N] [--size WxH] [--dt seconds] [--launch] [--salvo cannons] [--wind] [--dispersion samples] [--sampling random|sobol|halton] [--target meters] [--csv out.csv]
+int main(int argc, char* argv[])
+{
+    int frameCount = 1000;
+    int warmup = 10;
+    float width = 1280.f;
+    float height = 720.f;
+    float deltaTime = 1.f / 60.f;
+    bool launch = false;
+    int salvoCannons = 0;
+    bool wind = false;
+    int dispersionSamples = 0;
+    Sampling sampling = DispersionSettings().sampling;
+    float targetError = 0.f;
+    const char* csvPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            sscanf(argv[++i], "%fx%f", &width, &height);
+        else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc)
+            deltaTime = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--launch") == 0)
+            launch = true;
+        else if (strcmp(argv[i], "--salvo") == 0 && i + 1 < argc)
+            salvoCannons = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--wind") == 0)
+            wind = true;
+        else if (strcmp(argv[i], "--dispersion") == 0 && i + 1 < argc)
+            dispersionSamples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sampling") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if (strcmp(name, "random") == 0)
+                sampling = Sampling::Random;
+            else if (strcmp(name, "sobol") == 0)
+                sampling = Sampling::Sobol;
+            else if (strcmp(name, "halton") == 0)
+                sampling = Sampling::Halton;
+            else
+            {
+                fprintf(stderr, "Unknown sampling '%s'\n", name);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+            targetError = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+            csvPath = argv[++i];
+        else
+        {
+            fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (frameCount < 1 || width <= 0.f || height <= 0.f || deltaTime <= 0.f)
+    {
+        fprintf(stderr, "Invalid settings\n");
+        return 2;
+    }
+
+    // Setup Dear ImGui context, same configuration as the windowed game
+    ImGui::SetAllocatorFunctions(CountingAlloc, CountingFree);
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    io.IniFilename = nullptr; // Don't depend on (nor overwrite) imgui.ini
+    io.DisplaySize = ImVec2(width, height);
+    io.DeltaTime = deltaTime;
+    ImGui::StyleColorsDark();
+
+    // The atlas has to be built for NewFrame, it is never uploaded
+    unsigned char* pixels;
+    int atlasWidth, atlasHeight;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &atlasWidth, &atlasHeight);
+
+    PROFILE_THREAD_NAME("Main");
+
+    App* app = new App();
+    if (wind)
+        app->EnableWind();
+    if (dispersionSamples > 0)
+    {
+        // Accumulated over the first frames, the later ones only draw
+        MonteCarloSettings& monteCarlo = app->GetMonteCarlo();
+        monteCarlo.enabled = true;
+        monteCarlo.samples = dispersionSamples;
+        monteCarlo.targetError = targetError;
+        monteCarlo.dispersion.sampling = sampling;
+    }
+    if (salvoCannons > 0)
+    {
+        // Auto fire keeps the pool busy
+        SalvoSettings& salvo = app->GetSalvo();
+        salvo.enabled = true;
+        salvo.autoFire = true;
+        salvo.cannons = salvoCannons;
+    }
+    std::vector<HeadlessFrame> frames;
+    frames.reserve(frameCount);
+
+    for (int i = 0; i < warmup + frameCount; i++)
+    {
+        PROFILE_SCOPE("Frame");
+        long long imguiStart = imguiAllocations;
+        long long newStart = newAllocations;
+        uint64_t frameStart = Profiler::Now();
+
+        io.DeltaTime = deltaTime;
+        ImGui::NewFrame();
+
+        if (launch)
+            app->Launch();
+
+        uint64_t start = Profiler::Now();
+        {
+            PROFILE_SCOPE("App::Update");
+            app->Update(deltaTime);
+        }
+        uint64_t updateEnd = Profiler::Now();
+        {
+            PROFILE_SCOPE("ImGui::Render");
+            ImGui::Render();
+        }
+        uint64_t frameEnd = Profiler::Now();
+
+        // Fed like the windowed game so the Performance window has data to draw
+        PerfOverlay& perf = app->GetPerf();
+        perf.Add(PERF_FRAME, (frameEnd - frameStart) / 1e6f);
+        perf.Add(PERF_UPDATE, (updateEnd - start) / 1e6f);
+        perf.Add(PERF_RENDER, (frameEnd - updateEnd) / 1e6f);
+        perf.Add(PERF_VERTICES, (float)ImGui::GetDrawData()->TotalVtxCount);
+        perf.Add(PERF_INDICES, (float)ImGui::GetDrawData()->TotalIdxCount);
+
+        if (i < warmup)
+            continue;
+
+        HeadlessFrame frame;
+        frame.cpuMs = (frameEnd - frameStart) / 1e6f;
+        frame.updateMs = (updateEnd - start) / 1e6f;
+        frame.renderMs = (frameEnd - updateEnd) / 1e6f;
+        frame.imguiAllocations = imguiAllocations - imguiStart;
+        frame.newAllocations = newAllocations - newStart;
+        frame.vertices = ImGui::GetDrawData()->TotalVtxCount;
+        frame.indices = ImGui::GetDrawData()->TotalIdxCount;
+        frame.rounds = app->GetSalvoRounds();
+        frames.push_back(frame);
+    }
+
+    long long dispersionDone = app->GetDispersionSamples();
+    float2 dispersionMean = DispersionMean(app->GetDispersion());
+    float2 meanError = { 0.f, 0.f }, deviationError = { 0.f, 0.f };
+    bool confidence = DispersionConfidence(app->GetDispersion(), meanError, deviationError);
+    delete app;
+    ImGui::DestroyContext();
+
+    if (csvPath != nullptr)
+    {
+        FILE* file = fopen(csvPath, "w");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "Cannot write '%s'\n", csvPath);
+            return 1;
+        }
+
+        fprintf(file, "frame,cpu_ms,update_ms,render_ms,imgui_allocations,new_allocations,vertices,indices,rounds\n");
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            const HeadlessFrame& f = frames[i];
+            fprintf(file, "%zu,%.4f,%.4f,%.4f,%lld,%lld,%d,%d,%d\n", i,
+                f.cpuMs, f.updateMs, f.renderMs, f.imguiAllocations, f.newAllocations, f.vertices, f.indices, f.rounds);
+        }
+        fclose(file);
+    }
+
+    std::vector<float> cpu, update, render;
+    std::vector<long long> imgui, news;
+    std::vector<int> vertices, indices, rounds;
+    for (const HeadlessFrame& f : frames)
+    {
+        cpu.push_back(f.cpuMs);
+        update.push_back(f.updateMs);
+        render.push_back(f.renderMs);
+        imgui.push_back(f.imguiAllocations);
+        news.push_back(f.newAllocations);
+        vertices.push_back(f.vertices);
+        indices.push_back(f.indices);
+        rounds.push_back(f.rounds);
+    }
+
+    printf("%d frames at %.0fx%.0f, dt %.4f s%s\n", frameCount, width, height, deltaTime, launch ? ", launching" : "");
+    if (salvoCannons > 0)
+        printf("Salvo of %d cannons, auto fire%s\n", salvoCannons, wind ? ", air drag and wind" : "");
+    if (dispersionSamples > 0)
+    {
+        static const char* samplingNames[] = { "random", "sobol", "halton" };
+        printf("Monte Carlo dispersion: %lld / %d samples (%s)\n", dispersionDone, dispersionSamples, samplingNames[(int)sampling]);
+        if (confidence)
+            printf("Mean impact: x = %.5f +-%.5f y = %.5f +-%.5f (95%%)\n", dispersionMean.x, meanError.x, dispersionMean.y, meanError.y);
+    }
+    printf("%-20s %10s %10s %10s %10s\n", "", "p50", "p95", "p99", "max");
+    printf("%-20s %10.4f %10.4f %10.4f %10.4f\n", "CPU (ms)", Percentile(cpu, 0.5f), Percentile(cpu, 0.95f), Percentile(cpu, 0.99f), Percentile(cpu, 1.f));
+    printf("%-20s %10.4f %10.4f %10.4f %10.4f\n", "App::Update (ms)", Percentile(update, 0.5f), Percentile(update, 0.95f), Percentile(update, 0.99f), Percentile(update, 1.f));
+    printf("%-20s %10.4f %10.4f %10.4f %10.4f\n", "ImGui::Render (ms)", Percentile(render, 0.5f), Percentile(render, 0.95f), Percentile(render, 0.99f), Percentile(render, 1.f));
+    printf("%-20s %10lld %10lld %10lld %10lld\n", "ImGui allocations", Percentile(imgui, 0.5f), Percentile(imgui, 0.95f), Percentile(imgui, 0.99f), Percentile(imgui, 1.f));
+    printf("%-20s %10lld %10lld %10lld %10lld\n", "new allocations", Percentile(news, 0.5f), Percentile(news, 0.95f), Percentile(news, 0.99f), Percentile(news, 1.f));
+    printf("%-20s %10d %10d %10d %10d\n", "Vertices", Percentile(vertices, 0.5f), Percentile(vertices, 0.95f), Percentile(vertices, 0.99f), Percentile(vertices, 1.f));
+    printf("%-20s %10d %10d %10d %10d\n", "Indices", Percentile(indices, 0.5f), Percentile(indices, 0.95f), Percentile(indices, 0.99f), Percentile(indices, 1.f));
+    if (salvoCannons > 0)
+        printf("%-20s %10d %10d %10d %10d\n", "Rounds", Percentile(rounds, 0.5f), Percentile(rounds, 0.95f), Percentile(rounds, 0.99f), Percentile(rounds, 1.f));
+
+    return 0;
+}
@@ -0,0 +1,580 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+
+#include "calc.hpp"
+#include "simulation.hpp"
+#include "wind_field.hpp"
+
+// Numerical integration of the free flight
+// Integrators and force models are compile time policies: IntegrateFlight<RK4>(GravityModel(), ...) compiles to
+// one specialized loop where the force model is inlined in the integrator step, no virtual call.
+
+struct IntegratorSettings
+{
+    float step = 1.f / 120.f;  // Fixed step, first try of the adaptive integrators (s)
+    float tolerance = 1e-4f;   // Adaptive: max local error on position (m) and velocity (m/s)
+    float minStep = 1e-5f;     // Adaptive step bounds (s)
+    float maxStep = 1.f;
+    float maxTime = 600.f;     // Flights longer than this never land (s)
+    int maxSteps = 1000000;
+};
+
+// What a flight cost, to pick the cheapest integrator that meets the accuracy needed
+struct IntegrationStats
+{
+    int steps;            // Accepted steps
+    int rejectedSteps;    // Adaptive: steps retried with a smaller step
+    int forceEvaluations;
+    float minStep;        // Accepted step range (s)
+    float maxStep;
+    float maxError;       // Adaptive: largest accepted local error estimate, relative to the tolerance
+};
+
+static inline void AddStep(IntegrationStats& stats, float dt)
+{
+    stats.minStep = stats.steps == 0 ? dt : fminf(stats.minStep, dt);
+    stats.maxStep = stats.steps == 0 ? dt : fmaxf(stats.maxStep, dt);
+    stats.steps++;
+}
+
+// Force models: acceleration of the body at time t
+
+struct GravityModel
+{
+    float2 operator()(float t, const BodyState& state) const
+    {
+        return { 0.f, -GRAVITY };
+    }
+};
+
+// Gravity and quadratic air drag: a = -g - k |v - w| (v - w) with k = rho * Cd * A / (2 * mass)
+// The wind w is sampled at the body position on every evaluation
+struct DragModel
+{
+    float k;
+    const WindField* wind;
+    float windScale;
+    float2 steadyWind; // Added to the wind of the field (m/s)
+
+    DragModel(const AirDrag& drag, float mass)
+        : k(drag.enabled && mass > 0.f ? 0.5f * drag.airDensity * drag.dragCoefficient * drag.area / mass : 0.f),
+        wind(drag.enabled ? drag.wind : nullptr), windScale(drag.windScale), steadyWind{ 0.f, 0.f }
+    {
+    }
+
+    float2 operator()(float t, const BodyState& state) const
+    {
+        float2 airSpeed = state.velocity - steadyWind;
+        if (wind != nullptr)
+            airSpeed = airSpeed - wind->Sample(state.position) * windScale;
+        return float2{ 0.f, -GRAVITY } - airSpeed * (k * length(airSpeed));
+    }
+};
+
+// Integrators
+// Step advances state from t by the returned step. dt is the step to try and receives the next one to try.
+// IntegrateFlight uses one integrator object per flight, so an integrator can carry state between its steps.
+
+// First order, position updated with the old velocity
+struct ExplicitEuler
+{
+    static const char* Name() { return "Explicit Euler"; }
+
+    template<typename Force>
+    static inline float Step(const Force& force, BodyState& state, float t, float& dt, const IntegratorSettings&, IntegrationStats& stats)
+    {
+        float2 a = force(t, state);
+        state.position += state.velocity * dt;
+        state.velocity += a * dt;
+        stats.forceEvaluations++;
+        return dt;
+    }
+};
+
+// First order, symplectic: position updated with the new velocity
+struct SemiImplicitEuler
+{
+    static const char* Name() { return "Semi-implicit Euler"; }
+
+    template<typename Force>
+    static inline float Step(const Force& force, BodyState& state, float t, float& dt, const IntegratorSettings&, IntegrationStats& stats)
+    {
+        float2 a = force(t, state);
+        state.velocity += a * dt;
+        state.position += state.velocity * dt;
+        stats.forceEvaluations++;
+        return dt;
+    }
+};
+
+// Second order, exact for a constant acceleration
+// Velocity dependent forces are evaluated with the velocity predicted by Euler at the end of the step
+struct VelocityVerlet
+{
+    static const char* Name() { return "Velocity Verlet"; }
+
+    template<typename Force>
+    static inline float Step(const Force& force, BodyState& state, float t, float& dt, const IntegratorSettings&, IntegrationStats& stats)
+    {
+        float2 a0 = force(t, state);
+        BodyState end = { state.position + state.velocity * dt + a0 * (0.5f * dt * dt), state.velocity + a0 * dt };
+        float2 a1 = force(t + dt, end);
+        state.position = end.position;
+        state.velocity += (a0 + a1) * (0.5f * dt);
+        stats.forceEvaluations += 2;
+        return dt;
+    }
+};
+
+// Classic fourth order Runge-Kutta
+struct RK4
+{
+    static const char* Name() { return "RK4"; }
+
+    template<typename Force>
+    static inline float Step(const Force& force, BodyState& state, float t, float& dt, const IntegratorSettings&, IntegrationStats& stats)
+    {
+        const BodyState& s = state;
+        float2 v1 = s.velocity;
+        float2 a1 = force(t, s);
+        BodyState s2 = { s.position + v1 * (0.5f * dt), s.velocity + a1 * (0.5f * dt) };
+        float2 v2 = s2.velocity;
+        float2 a2 = force(t + 0.5f * dt, s2);
+        BodyState s3 = { s.position + v2 * (0.5f * dt), s.velocity + a2 * (0.5f * dt) };
+        float2 v3 = s3.velocity;
+        float2 a3 = force(t + 0.5f * dt, s3);
+        BodyState s4 = { s.position + v3 * dt, s.velocity + a3 * dt };
+        float2 v4 = s4.velocity;
+        float2 a4 = force(t + dt, s4);
+
+        state.position += (v1 + v2 * 2.f + v3 * 2.f + v4) * (dt / 6.f);
+        state.velocity += (a1 + a2 * 2.f + a3 * 2.f + a4) * (dt / 6.f);
+        stats.forceEvaluations += 4;
+        return dt;
+    }
+};
+
+// Bodies stepped together by DormandPrince45::StepBatch, sized once so no step allocates
+// The caller fills the first count entries, StepBatch replaces them by the accepted steps
+struct DormandPrince45Batch
+{
+    std::vector<int> bodies;       // Caller index of each entry, passed to the force model
+    std::vector<BodyState> states; // Start of the step, then its end
+    std::vector<float2> k1;        // Acceleration at the state, first same as last
+    std::vector<float> dt;         // Step to try, then the next one to try
+    std::vector<float> taken;      // Accepted step
+
+    // IntegrateFlightBatch: start of the step, flight time and accepted steps of each flight
+    std::vector<BodyState> start;
+    std::vector<float> time;
+    std::vector<int> steps;
+
+    // Scratch of the entries still stepping, stage values stored by stage
+    std::vector<int> active, activeBodies;
+    std::vector<float> h;
+    std::vector<BodyState> stage;
+    std::vector<float2> v[6], k[6]; // Stages 2 to 7
+
+    void Resize(int capacity)
+    {
+        bodies.resize(capacity);
+        states.resize(capacity);
+        k1.resize(capacity);
+        dt.resize(capacity);
+        taken.resize(capacity);
+        start.resize(capacity);
+        time.resize(capacity);
+        steps.resize(capacity);
+        active.resize(capacity);
+        activeBodies.resize(capacity);
+        h.resize(capacity);
+        stage.resize(capacity);
+        for (int i = 0; i < 6; i++)
+        {
+            v[i].resize(capacity);
+            k[i].resize(capacity);
+        }
+    }
+};
+
+// Adaptive Dormand-Prince 5(4): fifth order solution, the embedded fourth order one estimates the local error
+struct DormandPrince45
+{
+    static const char* Name() { return "Dormand-Prince 45"; }
+
+    // Butcher tableau
+    static constexpr float c2 = 1.f / 5.f, c3 = 3.f / 10.f, c4 = 4.f / 5.f, c5 = 8.f / 9.f;
+    static constexpr float a21 = 1.f / 5.f;
+    static constexpr float a31 = 3.f / 40.f, a32 = 9.f / 40.f;
+    static constexpr float a41 = 44.f / 45.f, a42 = -56.f / 15.f, a43 = 32.f / 9.f;
+    static constexpr float a51 = 19372.f / 6561.f, a52 = -25360.f / 2187.f, a53 = 64448.f / 6561.f, a54 = -212.f / 729.f;
+    static constexpr float a61 = 9017.f / 3168.f, a62 = -355.f / 33.f, a63 = 46732.f / 5247.f, a64 = 49.f / 176.f, a65 = -5103.f / 18656.f;
+    static constexpr float b1 = 35.f / 384.f, b3 = 500.f / 1113.f, b4 = 125.f / 192.f, b5 = -2187.f / 6784.f, b6 = 11.f / 84.f;
+    // Fifth minus fourth order weights
+    static constexpr float e1 = 71.f / 57600.f, e3 = -71.f / 16695.f, e4 = 71.f / 1920.f, e5 = -17253.f / 339200.f, e6 = 22.f / 525.f, e7 = -1.f / 40.f;
+
+    // Optimal step for a fifth order error, with a safety factor and bounded growth
+    static float StepFactor(float error)
+    {
+        float factor = error > 0.f ? 0.9f * powf(error, -0.2f) : 5.f;
+        return fminf(fmaxf(factor, 0.2f), 5.f);
+    }
+
+    // First same as last: the derivative at the end of an accepted step is the first stage of the next one
+    float2 k1;
+    bool hasK1 = false;
+
+    template<typename Force>
+    inline float Step(const Force& force, BodyState& state, float t, float& dt, const IntegratorSettings& settings, IntegrationStats& stats)
+    {
+        const BodyState& s = state;
+        if (!hasK1)
+        {
+            k1 = force(t, s);
+            hasK1 = true;
+            stats.forceEvaluations++;
+        }
+
+        while (true)
+        {
+            float h = fminf(fmaxf(dt, settings.minStep), settings.maxStep);
+
+            // Stages, the derivative of (position, velocity) is (velocity, acceleration)
+            float2 v1 = s.velocity;
+            BodyState s2 = { s.position + v1 * (h * a21), s.velocity + k1 * (h * a21) };
+            float2 v2 = s2.velocity;
+            float2 k2 = force(t + c2 * h, s2);
+            BodyState s3 = { s.position + (v1 * a31 + v2 * a32) * h, s.velocity + (k1 * a31 + k2 * a32) * h };
+            float2 v3 = s3.velocity;
+            float2 k3 = force(t + c3 * h, s3);
+            BodyState s4 = { s.position + (v1 * a41 + v2 * a42 + v3 * a43) * h, s.velocity + (k1 * a41 + k2 * a42 + k3 * a43) * h };
+            float2 v4 = s4.velocity;
+            float2 k4 = force(t + c4 * h, s4);
+            BodyState s5 = { s.position + (v1 * a51 + v2 * a52 + v3 * a53 + v4 * a54) * h,
+                s.velocity + (k1 * a51 + k2 * a52 + k3 * a53 + k4 * a54) * h };
+            float2 v5 = s5.velocity;
+            float2 k5 = force(t + c5 * h, s5);
+            BodyState s6 = { s.position + (v1 * a61 + v2 * a62 + v3 * a63 + v4 * a64 + v5 * a65) * h,
+                s.velocity + (k1 * a61 + k2 * a62 + k3 * a63 + k4 * a64 + k5 * a65) * h };
+            float2 v6 = s6.velocity;
+            float2 k6 = force(t + h, s6);
+            BodyState next = { s.position + (v1 * b1 + v3 * b3 + v4 * b4 + v5 * b5 + v6 * b6) * h,
+                s.velocity + (k1 * b1 + k3 * b3 + k4 * b4 + k5 * b5 + k6 * b6) * h };
+            float2 v7 = next.velocity;
+            float2 k7 = force(t + h, next);
+            stats.forceEvaluations += 6;
+
+            float2 errorPosition = (v1 * e1 + v3 * e3 + v4 * e4 + v5 * e5 + v6 * e6 + v7 * e7) * h;
+            float2 errorVelocity = (k1 * e1 + k3 * e3 + k4 * e4 + k5 * e5 + k6 * e6 + k7 * e7) * h;
+            float error = fmaxf(length(errorPosition), length(errorVelocity)) / settings.tolerance;
+
+            float factor = StepFactor(error);
+            if (error <= 1.f || h <= settings.minStep)
+            {
+                state = next;
+                k1 = k7;
+                dt = h * factor;
+                stats.maxError = fmaxf(stats.maxError, error);
+                return h;
+            }
+
+            stats.rejectedSteps++;
+            dt = h * factor;
+        }
+    }
+
+    // One accepted step of every body of the batch, in lockstep: each stage evaluates the force of all the bodies in one call,
+    // force(bodies, states, accelerations, n), so a force model can sample the wind of the whole batch at once.
+    // Per body, the same operations as Step: a body gets the step it would get alone. Accepted steps are added to stats
+    template<typename BatchForce>
+    static void StepBatch(const BatchForce& force, DormandPrince45Batch& batch, int count, const IntegratorSettings& settings, IntegrationStats& stats)
+    {
+        int n = count;
+        int* active = batch.active.data();
+        int* bodies = batch.activeBodies.data();
+        float* h = batch.h.data();
+        BodyState* stage = batch.stage.data();
+        float2* v2 = batch.v[0].data(); float2* v3 = batch.v[1].data(); float2* v4 = batch.v[2].data();
+        float2* v5 = batch.v[3].data(); float2* v6 = batch.v[4].data(); float2* v7 = batch.v[5].data();
+        float2* k2 = batch.k[0].data(); float2* k3 = batch.k[1].data(); float2* k4 = batch.k[2].data();
+        float2* k5 = batch.k[3].data(); float2* k6 = batch.k[4].data(); float2* k7 = batch.k[5].data();
+        for (int i = 0; i < n; i++)
+            active[i] = i;
+
+        // Rejected bodies retry together until all of them took a step
+        while (n > 0)
+        {
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                bodies[j] = batch.bodies[i];
+                h[j] = fminf(fmaxf(batch.dt[i], settings.minStep), settings.maxStep);
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + v1 * (h[j] * a21), s.velocity + k1 * (h[j] * a21) };
+                v2[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k2, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + (v1 * a31 + v2[j] * a32) * h[j], s.velocity + (k1 * a31 + k2[j] * a32) * h[j] };
+                v3[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k3, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + (v1 * a41 + v2[j] * a42 + v3[j] * a43) * h[j],
+                    s.velocity + (k1 * a41 + k2[j] * a42 + k3[j] * a43) * h[j] };
+                v4[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k4, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + (v1 * a51 + v2[j] * a52 + v3[j] * a53 + v4[j] * a54) * h[j],
+                    s.velocity + (k1 * a51 + k2[j] * a52 + k3[j] * a53 + k4[j] * a54) * h[j] };
+                v5[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k5, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + (v1 * a61 + v2[j] * a62 + v3[j] * a63 + v4[j] * a64 + v5[j] * a65) * h[j],
+                    s.velocity + (k1 * a61 + k2[j] * a62 + k3[j] * a63 + k4[j] * a64 + k5[j] * a65) * h[j] };
+                v6[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k6, n);
+
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                const BodyState& s = batch.states[i];
+                float2 v1 = s.velocity, k1 = batch.k1[i];
+                stage[j] = { s.position + (v1 * b1 + v3[j] * b3 + v4[j] * b4 + v5[j] * b5 + v6[j] * b6) * h[j],
+                    s.velocity + (k1 * b1 + k3[j] * b3 + k4[j] * b4 + k5[j] * b5 + k6[j] * b6) * h[j] };
+                v7[j] = stage[j].velocity;
+            }
+            force(bodies, stage, k7, n);
+            stats.forceEvaluations += 6 * n;
+
+            // Accepted bodies leave the batch, the rejected ones are packed in place for the retry
+            int rejected = 0;
+            for (int j = 0; j < n; j++)
+            {
+                int i = active[j];
+                float2 v1 = batch.states[i].velocity, k1 = batch.k1[i];
+                float2 errorPosition = (v1 * e1 + v3[j] * e3 + v4[j] * e4 + v5[j] * e5 + v6[j] * e6 + v7[j] * e7) * h[j];
+                float2 errorVelocity = (k1 * e1 + k3[j] * e3 + k4[j] * e4 + k5[j] * e5 + k6[j] * e6 + k7[j] * e7) * h[j];
+                float error = fmaxf(length(errorPosition), length(errorVelocity)) / settings.tolerance;
+                float factor = StepFactor(error);
+                batch.dt[i] = h[j] * factor;
+
+                if (error <= 1.f || h[j] <= settings.minStep)
+                {
+                    batch.states[i] = stage[j];
+                    batch.k1[i] = k7[j];
+                    batch.taken[i] = h[j];
+                    stats.maxError = fmaxf(stats.maxError, error);
+                    AddStep(stats, h[j]);
+                    continue;
+                }
+
+                stats.rejectedSteps++;
+                active[rejected++] = i;
+            }
+            n = rejected;
+        }
+    }
+};
+
+// Cubic Hermite interpolation of the end states of a step, s in [0, 1]
+static inline float2 HermitePosition(const BodyState& start, const BodyState& end, float dt, float s)
+{
+    float s2 = s * s;
+    float s3 = s2 * s;
+    return start.position * (2.f * s3 - 3.f * s2 + 1.f) + start.velocity * ((s3 - 2.f * s2 + s) * dt)
+        + end.position * (-2.f * s3 + 3.f * s2) + end.velocity * ((s3 - s2) * dt);
+}
+
+static inline float2 HermiteVelocity(const BodyState& start, const BodyState& end, float dt, float s)
+{
+    float s2 = s * s;
+    return (start.position * (6.f * s2 - 6.f * s) + end.position * (-6.f * s2 + 6.f * s)) / dt
+        + start.velocity * (3.f * s2 - 4.f * s + 1.f) + end.velocity * (3.f * s2 - 2.f * s);
+}
+
+// Flight observer doing nothing, see IntegrateFlight
+struct NoFlightObserver
+{
+    void operator()(float t, const BodyState& state) const {}
+};
+
+// Cancel predicate never raised, see IntegrateFlight
+struct NeverCancel
+{
+    bool operator()() const { return false; }
+};
+
+// Integrates the free flight of a shot from its barrel exit to the ground contact
+// The barrel phase keeps its closed form, the contact is located inside the last step
+// observer(t, state) receives the exit state, every accepted step and the contact state
+// cancel() is tested after every accepted step, once raised the flight stops there (not landed)
+template<typename Integrator, typename Force, typename Observer, typename Cancel>
+ShotResult IntegrateFlight(const Force& force, const Trajectory& trajectory, const IntegratorSettings& settings, IntegrationStats& stats,
+    Observer&& observer, Cancel&& cancel)
+{
+    stats = {};
+    ShotResult result = {};
+    if (!trajectory.exits)
+    {
+        result.flightTime = trajectory.impactTime;
+        result.impact = trajectory.impact;
+        result.recoil = trajectory.recoilSpeed * trajectory.impactTime;
+        return result;
+    }
+
+    BodyState state = { trajectory.exitPoint, trajectory.exitSpeed };
+    float t = trajectory.exitTime;
+    float dt = settings.step;
+    observer(t, state);
+    float end = trajectory.exitTime + settings.maxTime;
+    Integrator integrator = {};
+    while (t < end && stats.steps < settings.maxSteps)
+    {
+        BodyState start = state;
+        float taken = integrator.Step(force, state, t, dt, settings, stats);
+        AddStep(stats, taken);
+
+        if (state.position.y <= GROUND_HEIGHT)
+        {
+            float s = GroundContact(start, state, taken);
+            result.landed = true;
+            result.flightTime = t + s * taken;
+            result.impact = HermitePosition(start, state, taken, s);
+            result.impact.y = GROUND_HEIGHT;
+            observer(result.flightTime, BodyState{ result.impact, HermiteVelocity(start, state, taken, s) });
+            break;
+        }
+        t += taken;
+        observer(t, state);
+        if (cancel())
+            break;
+    }
+
+    if (!result.landed)
+    {
+        result.flightTime = t;
+        result.impact = state.position;
+    }
+    result.recoil = trajectory.recoilSpeed * result.flightTime;
+    return result;
+}
+
+template<typename Integrator, typename Force, typename Observer>
+ShotResult IntegrateFlight(const Force& force, const Trajectory& trajectory, const IntegratorSettings& settings, IntegrationStats& stats, Observer&& observer)
+{
+    return IntegrateFlight<Integrator>(force, trajectory, settings, stats, observer, NeverCancel());
+}
+
+template<typename Integrator, typename Force>
+ShotResult IntegrateFlight(const Force& force, const Trajectory& trajectory, const IntegratorSettings& settings, IntegrationStats& stats)
+{
+    return IntegrateFlight<Integrator>(force, trajectory, settings, stats, NoFlightObserver());
+}
+
+// Flights of many shots integrated together by DormandPrince45::StepBatch, each one as IntegrateFlight<DormandPrince45>
+// integrates it alone: force(bodies, states, accelerations, n) gets the indices of the shots in trajectories,
+// so a force model can sample the wind at all of their stage positions at once. batch holds count flights at least
+template<typename BatchForce>
+void IntegrateFlightBatch(const BatchForce& force, const Trajectory* trajectories, ShotResult* results, int count,
+    const IntegratorSettings& settings, DormandPrince45Batch& batch, IntegrationStats& stats)
+{
+    stats = {};
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const Trajectory& trajectory = trajectories[i];
+        results[i] = {};
+        if (!trajectory.exits)
+        {
+            results[i].flightTime = trajectory.impactTime;
+            results[i].impact = trajectory.impact;
+            results[i].recoil = trajectory.recoilSpeed * trajectory.impactTime;
+            continue;
+        }
+
+        batch.bodies[n] = i;
+        batch.states[n] = { trajectory.exitPoint, trajectory.exitSpeed };
+        batch.dt[n] = settings.step;
+        batch.time[n] = trajectory.exitTime;
+        batch.steps[n] = 0;
+        n++;
+    }
+    force(batch.bodies.data(), batch.states.data(), batch.k1.data(), n);
+    stats.forceEvaluations += n;
+
+    while (n > 0)
+    {
+        for (int j = 0; j < n; j++)
+            batch.start[j] = batch.states[j];
+        DormandPrince45::StepBatch(force, batch, n, settings, stats);
+
+        // Landed and given up flights leave the batch, the others are packed for the next step
+        int flying = 0;
+        for (int j = 0; j < n; j++)
+        {
+            const Trajectory& trajectory = trajectories[batch.bodies[j]];
+            ShotResult& result = results[batch.bodies[j]];
+            const BodyState& start = batch.start[j];
+            const BodyState& state = batch.states[j];
+            float taken = batch.taken[j];
+            float t = batch.time[j];
+            int steps = batch.steps[j] + 1;
+
+            if (state.position.y <= GROUND_HEIGHT)
+            {
+                float s = GroundContact(start, state, taken);
+                result.landed = true;
+                result.flightTime = t + s * taken;
+                result.impact = HermitePosition(start, state, taken, s);
+                result.impact.y = GROUND_HEIGHT;
+                result.recoil = trajectory.recoilSpeed * result.flightTime;
+                continue;
+            }
+
+            t += taken;
+            if (t >= trajectory.exitTime + settings.maxTime || steps >= settings.maxSteps)
+            {
+                result.flightTime = t;
+                result.impact = state.position;
+                result.recoil = trajectory.recoilSpeed * result.flightTime;
+                continue;
+            }
+
+            batch.bodies[flying] = batch.bodies[j];
+            batch.states[flying] = state;
+            batch.k1[flying] = batch.k1[j];
+            batch.dt[flying] = batch.dt[j];
+            batch.time[flying] = t;
+            batch.steps[flying] = steps;
+            flying++;
+        }
+        n = flying;
+    }
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+struct ParallelForJob
+{
+    const std::function<void(int, int)>* fn;
+    int grainSize;
+    std::atomic<int> remaining; // Elements not processed yet
+};
+
+// Queue used by the current thread (0 for threads that are not workers)
+static thread_local int currentQueue = 0;
+
+static void PinThread(std::thread& thread, int core)
+{
+#if defined(_WIN32)
+    SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << (core % 64));
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % CPU_SETSIZE, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0)
+        fprintf(stderr, "Cannot pin worker thread to core %d\n", core);
+#else
+    (void)thread;
+    (void)core;
+#endif
+}
+
+JobSystem::JobSystem(int threadCount, bool pinThreads)
+    : queuedRanges(0), sleepingWorkers(0), stop(false)
+{
+    if (threadCount <= 0)
+        threadCount = (int)std::thread::hardware_concurrency();
+    if (threadCount <= 0)
+        threadCount = 1;
+
+    int cores = (int)std::thread::hardware_concurrency();
+    queues = std::vector<WorkerQueue>(threadCount);
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+        if (pinThreads && cores > 0)
+            PinThread(workers.back(), i % cores);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stop = true;
+    }
+    sleepCondition.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void JobSystem::Push(int queue, const JobRange& range)
+{
+    {
+        std::lock_guard<std::mutex> lock(queues[queue].mutex);
+        queues[queue].ranges.push_back(range);
+    }
+    queuedRanges++;
+
+    // Sleepers check queuedRanges under sleepMutex, taking it here avoids lost wake ups
+    if (sleepingWorkers > 0)
+    {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        sleepCondition.notify_one();
+    }
+}
+
+bool JobSystem::Pop(int queue, JobRange& range)
+{
+    std::lock_guard<std::mutex> lock(queues[queue].mutex);
+    if (queues[queue].ranges.empty())
+        return false;
+
+    range = queues[queue].ranges.back();
+    queues[queue].ranges.pop_back();
+    queuedRanges--;
+    return true;
+}
+
+bool JobSystem::Steal(int thief, JobRange& range)
+{
+    int count = (int)queues.size();
+    for (int i = 1; i < count; i++)
+    {
+        WorkerQueue& victim = queues[(thief + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.ranges.empty())
+            continue;
+
+        // Oldest range is the biggest one
+        range = victim.ranges.front();
+        victim.ranges.pop_front();
+        queuedRanges--;
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(int queue, JobRange range)
+{
+    ParallelForJob* job = range.job;
+
+    // Keep the first half, give the second one away until the range fits the grain size
+    while (range.end - range.begin > job->grainSize)
+    {
+        int middle = range.begin + (range.end - range.begin) / 2;
+        Push(queue, { middle, range.end, job });
+        range.end = middle;
+    }
+
+    {
+        PROFILE_SCOPE("Job range");
+        (*job->fn)(range.begin, range.end);
+    }
+    job->remaining -= range.end - range.begin;
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+    currentQueue = index;
+    PROFILE_THREAD_NAME("Job worker");
+
+    while (!stop)
+    {
+        JobRange range;
+        if (Pop(index, range) || Steal(index, range))
+        {
+            Execute(index, range);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers++;
+        sleepCondition.wait(lock, [this]() { return stop || queuedRanges > 0; });
+        sleepingWorkers--;
+    }
+}
+
+void JobSystem::ParallelFor(int count, int grainSize, const std::function<void(int, int)>& fn)
+{
+    if (count <= 0)
+        return;
+
+    ParallelForJob job;
+    job.fn = &fn;
+    job.grainSize = grainSize > 0 ? grainSize : 1;
+    job.remaining = count;
+
+    int queue = currentQueue;
+    Push(queue, { 0, count, &job });
+
+    // Help until the whole job is done (other jobs may be run meanwhile)
+    while (job.remaining > 0)
+    {
+        JobRange range;
+        if (Pop(queue, range) || Steal(queue, range))
+            Execute(queue, range);
+        else
+            std::this_thread::yield();
+    }
+}
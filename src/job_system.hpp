@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+struct ParallelForJob;
+
+// Range of a ParallelFor waiting in a worker queue
+struct JobRange
+{
+    int begin;
+    int end;
+    ParallelForJob* job;
+};
+
+// Work stealing job system
+// Each worker owns a queue: it pops its newest range (LIFO) and steals the oldest range of the others (FIFO).
+// Ranges bigger than the grain size are split in halves, one half is pushed back for thieves.
+class JobSystem
+{
+public:
+    // threadCount <= 0 uses every hardware thread (the calling thread counts as one)
+    // pinThreads sets each worker thread affinity to a single core
+    JobSystem(int threadCount = 0, bool pinThreads = false);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Number of threads working on a ParallelFor, including the caller
+    int ThreadCount() const { return (int)queues.size(); }
+
+    // Calls fn(begin, end) on chunks of at most grainSize elements covering [0, count)
+    // Blocks until every chunk is done, the calling thread works too
+    void ParallelFor(int count, int grainSize, const std::function<void(int, int)>& fn);
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<JobRange> ranges;
+    };
+
+    void WorkerLoop(int index);
+    void Push(int queue, const JobRange& range);
+    bool Pop(int queue, JobRange& range);
+    bool Steal(int thief, JobRange& range);
+    void Execute(int queue, JobRange range);
+
+    std::vector<WorkerQueue> queues; // queues[0] is shared by the threads calling ParallelFor
+    std::vector<std::thread> workers;
+
+    std::atomic<int> queuedRanges;
+    std::atomic<int> sleepingWorkers;
+    std::atomic<bool> stop;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+};
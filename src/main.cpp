@@ -7,6 +7,7 @@
 #include <imgui_impl_opengl3.h>
 
 #include "app.hpp"
+#include "profiler.hpp"
 
 int main(int argc, char* argv[])
 {
@@ -50,31 +51,69 @@ int main(int argc, char* argv[])
 	double deltaTime = 0.0;
     // Main loop
 
+    PROFILE_THREAD_NAME("Main");
+
     while (!glfwWindowShouldClose(window))
     {
+        PROFILE_SCOPE("Frame");
 		double timeNow = glfwGetTime();
 		double timeEnd;
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        {
+            PROFILE_SCOPE("ImGui::NewFrame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
 
         //ImGui::ShowDemoWindow(nullptr);
 
-        app->Update((float)deltaTime);
+        PerfOverlay& perf = app->GetPerf();
+        perf.Add(PERF_FRAME, (float)deltaTime * 1000.f);
+
+        uint64_t start = Profiler::Now();
+        {
+            PROFILE_SCOPE("App::Update");
+            app->Update((float)deltaTime);
+        }
+        perf.Add(PERF_UPDATE, (Profiler::Now() - start) / 1e6f);
+
+#if PROFILER_ENABLED
+        // Dump the last zones of every thread
+        if (ImGui::IsKeyPressed(ImGuiKey_F2, false))
+            Profiler::WriteChromeTrace("trace.json");
+#endif
 
         // Rendering
-        ImGui::Render();
+        start = Profiler::Now();
+        {
+            PROFILE_SCOPE("ImGui::Render");
+            ImGui::Render();
+        }
+        perf.Add(PERF_RENDER, (Profiler::Now() - start) / 1e6f);
+        perf.Add(PERF_VERTICES, (float)ImGui::GetDrawData()->TotalVtxCount);
+        perf.Add(PERF_INDICES, (float)ImGui::GetDrawData()->TotalIdxCount);
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
         glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        start = Profiler::Now();
+        {
+            PROFILE_SCOPE("ImGui_ImplOpenGL3_RenderDrawData");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        perf.Add(PERF_DRAW, (Profiler::Now() - start) / 1e6f);
 
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 		timeEnd = glfwGetTime();
 		deltaTime = timeEnd - timeNow;
         glfwSetWindowShouldClose(window, glfwGetKey(window, GLFW_KEY_ESCAPE));
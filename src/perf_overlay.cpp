@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <float.h>
+#include <algorithm>
+
+#include <imgui.h>
+
+#include "perf_overlay.hpp"
+
+static const char* metricNames[PERF_COUNT] = {
+    "Frame (ms)",
+    "Update (ms)",
+    "Simulation (ms)",
+    "Preview build (ms)",
+    "ImGui::Render (ms)",
+    "RenderDrawData (ms)",
+    "Vertices",
+    "Indices",
+};
+
+void PerfSeries::Add(float value)
+{
+    if (count < PERF_HISTORY)
+    {
+        values[count++] = value;
+        return;
+    }
+
+    values[offset] = value;
+    offset = (offset + 1) % PERF_HISTORY;
+}
+
+float PerfSeries::Last() const
+{
+    if (count == 0)
+        return 0.f;
+    return values[(offset + count - 1) % PERF_HISTORY];
+}
+
+float PerfSeries::Percentile(float p) const
+{
+    if (count == 0)
+        return 0.f;
+
+    float sorted[PERF_HISTORY];
+    std::copy(values, values + count, sorted);
+
+    int rank = (int)(p * (count - 1) + 0.5f);
+    std::nth_element(sorted, sorted + rank, sorted + count);
+    return sorted[rank];
+}
+
+PerfOverlay::PerfOverlay()
+    : series()
+{
+}
+
+void PerfOverlay::Draw()
+{
+    if (ImGui::Begin("Performance"))
+    {
+        for (int i = 0; i < PERF_COUNT; i++)
+        {
+            const PerfSeries& s = series[i];
+            float p50 = s.Percentile(0.50f);
+            float p95 = s.Percentile(0.95f);
+            float p99 = s.Percentile(0.99f);
+
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "p50 %.3g  p95 %.3g  p99 %.3g", p50, p95, p99);
+
+            ImGui::Text("%s: %.3g", metricNames[i], s.Last());
+            ImGui::PushID(i);
+            ImGui::PlotHistogram("", s.values, s.count, s.offset, overlay, 0.f, p99 > 0.f ? p99 * 1.25f : FLT_MAX, ImVec2(-1.f, 40.f));
+            ImGui::PopID();
+        }
+    }
+    ImGui::End();
+}
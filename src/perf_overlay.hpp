@@ -0,0 +1,42 @@
+#pragma once
+
+// Frames kept by the performance window
+#define PERF_HISTORY 240
+
+enum PerfMetric
+{
+    PERF_FRAME,      // Whole frame (ms)
+    PERF_UPDATE,     // App::Update (ms)
+    PERF_SIMULATION, // Simulation ticks (ms)
+    PERF_PREVIEW,    // Last preview build, on the preview worker (ms)
+    PERF_RENDER,     // ImGui::Render (ms)
+    PERF_DRAW,       // ImGui_ImplOpenGL3_RenderDrawData (ms)
+    PERF_VERTICES,   // ImDrawData vertices
+    PERF_INDICES,    // ImDrawData indices
+    PERF_COUNT,
+};
+
+// Rolling window of the last PERF_HISTORY samples
+struct PerfSeries
+{
+    float values[PERF_HISTORY];
+    int count;
+    int offset; // Oldest sample
+
+    void Add(float value);
+    float Last() const;
+    // p in [0, 1]
+    float Percentile(float p) const;
+};
+
+// "Performance" window: rolling histograms with p50/p95/p99 of the frame timings
+class PerfOverlay
+{
+public:
+    PerfOverlay();
+
+    void Add(PerfMetric metric, float value) { series[metric].Add(value); }
+    void Draw();
+
+    PerfSeries series[PERF_COUNT];
+};
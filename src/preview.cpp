@@ -0,0 +1,11 @@
+#include "preview.hpp"
+
+bool BuildPreview(const Cannon& cannon, PreviewCurve& curve, const std::atomic<bool>& cancel)
+{
+    curve.trajectory = SolveTrajectory(cannon);
+    curve.drag = cannon.drag.enabled;
+    // A stale request stops inside the integration, not after it
+    bool finished = !curve.drag || SolveFlightPath(cannon, curve.path, FlightIntegratorSettings(), &cancel);
+    curve.valid = finished && !cancel;
+    return curve.valid;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <atomic>
+
+#include "flight.hpp"
+#include "simulation.hpp"
+
+// Trajectory preview of a cannon configuration
+struct PreviewCurve
+{
+    bool valid;
+    unsigned int generation; // Request that produced this curve
+    Trajectory trajectory;   // Vacuum shot
+    bool drag;               // The shot is path instead
+    FlightPath path;
+};
+
+// Builds the preview of a shot, returns false if cancel was raised before it finished
+bool BuildPreview(const Cannon& cannon, PreviewCurve& curve, const std::atomic<bool>& cancel);
@@ -0,0 +1,125 @@
+#include <math.h>
+
+#include "preview_cache.hpp"
+#include "wind_field.hpp"
+
+size_t PreviewKeyHash::operator()(const PreviewKey& key) const
+{
+    // FNV-1a over the quantized values
+    const int values[13] = { key.angle, key.v0, key.p0x, key.p0y, key.L, key.M, key.mass,
+        key.drag, key.dragCoefficient, key.area, key.airDensity, key.wind, key.windScale };
+    size_t hash = 14695981039346656037ull;
+    for (int value : values)
+    {
+        hash ^= (size_t)(unsigned int)value;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+PreviewKey MakePreviewKey(const Cannon& cannon)
+{
+    PreviewKey key;
+    key.angle = (int)lroundf(cannon.angle * PREVIEW_SCALE);
+    key.v0    = (int)lroundf(cannon.v0 * PREVIEW_SCALE);
+    key.p0x   = (int)lroundf(cannon.p0.x * PREVIEW_SCALE);
+    key.p0y   = (int)lroundf(cannon.p0.y * PREVIEW_SCALE);
+    key.L     = (int)lroundf(cannon.L * PREVIEW_SCALE);
+    key.M     = (int)lroundf(cannon.M * PREVIEW_SCALE);
+    key.mass  = (int)lroundf(cannon.projectile.mass * PREVIEW_SCALE);
+
+    const AirDrag& drag = cannon.drag;
+    key.drag            = drag.enabled ? 1 : 0;
+    key.dragCoefficient = drag.enabled ? (int)lroundf(drag.dragCoefficient * PREVIEW_SCALE) : 0;
+    key.area            = drag.enabled ? (int)lroundf(drag.area * PREVIEW_AREA_SCALE) : 0;
+    key.airDensity      = drag.enabled ? (int)lroundf(drag.airDensity * PREVIEW_SCALE) : 0;
+
+    bool wind           = drag.enabled && drag.wind != nullptr;
+    key.wind            = wind ? (int)drag.wind->Id() : 0;
+    key.windScale       = wind ? (int)lroundf(drag.windScale * PREVIEW_SCALE) : 0;
+    return key;
+}
+
+Cannon PreviewKeyCannon(const PreviewKey& key, const WindField* wind)
+{
+    // A single division of exact integers: the nearest float to the decimal value, like the slider's
+    Cannon cannon = {};
+    cannon.angle = key.angle / PREVIEW_SCALE;
+    cannon.v0    = key.v0 / PREVIEW_SCALE;
+    cannon.p0    = { key.p0x / PREVIEW_SCALE, key.p0y / PREVIEW_SCALE };
+    cannon.L     = key.L / PREVIEW_SCALE;
+    cannon.M     = key.M / PREVIEW_SCALE;
+    cannon.projectile.mass = key.mass / PREVIEW_SCALE;
+    cannon.drag.enabled = key.drag != 0;
+    cannon.drag.dragCoefficient = key.dragCoefficient / PREVIEW_SCALE;
+    cannon.drag.area = key.area / PREVIEW_AREA_SCALE;
+    cannon.drag.airDensity = key.airDensity / PREVIEW_SCALE;
+    cannon.drag.wind = key.wind != 0 ? wind : nullptr;
+    cannon.drag.windScale = key.windScale / PREVIEW_SCALE;
+    cannon.position = cannon.p0;
+    return cannon;
+}
+
+bool PreviewKeyExact(const PreviewKey& key, const Cannon& cannon)
+{
+    Cannon grid = PreviewKeyCannon(key, cannon.drag.wind);
+    if (grid.angle != cannon.angle || grid.v0 != cannon.v0 || grid.p0.x != cannon.p0.x || grid.p0.y != cannon.p0.y
+        || grid.L != cannon.L || grid.M != cannon.M || grid.projectile.mass != cannon.projectile.mass)
+        return false;
+    if (!cannon.drag.enabled)
+        return true;
+
+    const AirDrag& drag = cannon.drag;
+    return grid.drag.dragCoefficient == drag.dragCoefficient && grid.drag.area == drag.area
+        && grid.drag.airDensity == drag.airDensity && (drag.wind == nullptr || grid.drag.windScale == drag.windScale);
+}
+
+PreviewCache::PreviewCache(int budget)
+    : budget(budget)
+{
+}
+
+bool PreviewCache::Find(const PreviewKey& key, PreviewCurve& curve)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end())
+        return false;
+
+    entries.splice(entries.begin(), entries, it->second);
+    curve = it->second->second;
+    return true;
+}
+
+bool PreviewCache::Contains(const PreviewKey& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.find(key) != index.end();
+}
+
+void PreviewCache::Insert(const PreviewKey& key, const PreviewCurve& curve)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        it->second->second = curve;
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+
+    entries.emplace_front(key, curve);
+    index[key] = entries.begin();
+
+    while ((int)entries.size() > budget)
+    {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+int PreviewCache::Size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int)entries.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "preview.hpp"
+
+// Quantization of the cache keys, they match the precision of the settings sliders (ImGui rounds to the format)
+// A key holds value * scale, its cannon divides back: the slider values on the grid round trip exactly
+#define PREVIEW_SCALE      1000.f  // ImGui default "%.3f"
+#define PREVIEW_AREA_SCALE 10000.f // "%.0f cm2"
+
+// Quantized parameters of a shot
+struct PreviewKey
+{
+    int angle, v0, p0x, p0y, L, M, mass;
+    int drag, dragCoefficient, area, airDensity; // Drag parameters are 0 without drag
+    int wind, windScale;                         // WindField::Id, 0 in still air
+
+    bool operator==(const PreviewKey& other) const
+    {
+        return angle == other.angle && v0 == other.v0 && p0x == other.p0x && p0y == other.p0y
+            && L == other.L && M == other.M && mass == other.mass
+            && drag == other.drag && dragCoefficient == other.dragCoefficient && area == other.area && airDensity == other.airDensity
+            && wind == other.wind && windScale == other.windScale;
+    }
+};
+
+struct PreviewKeyHash
+{
+    size_t operator()(const PreviewKey& key) const;
+};
+
+PreviewKey MakePreviewKey(const Cannon& cannon);
+// Cannon with the exact parameters of the key, the key only identifies the wind field: it is given back
+Cannon PreviewKeyCannon(const PreviewKey& key, const WindField* wind);
+// The cannon is exactly the one of its key: only then can a cached preview stand for it
+bool PreviewKeyExact(const PreviewKey& key, const Cannon& cannon);
+
+// Thread safe LRU cache of previews
+class PreviewCache
+{
+public:
+    PreviewCache(int budget = 512);
+
+    // Copies the cached preview and marks it as recently used
+    bool Find(const PreviewKey& key, PreviewCurve& curve);
+    bool Contains(const PreviewKey& key);
+    // Evicts the least recently used previews above the budget
+    void Insert(const PreviewKey& key, const PreviewCurve& curve);
+
+    int Size();
+
+private:
+    typedef std::pair<PreviewKey, PreviewCurve> Entry;
+
+    std::mutex mutex;
+    int budget;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<PreviewKey, std::list<Entry>::iterator, PreviewKeyHash> index;
+};
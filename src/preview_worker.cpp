@@ -0,0 +1,175 @@
+#include <math.h>
+
+#include "preview_worker.hpp"
+#include "profiler.hpp"
+
+// Neighbours by increasing distance, the two keys around d steps: angle +d, v0 +d, angle -d, v0 -d
+#define N_PREFETCH_KEYS (PREVIEW_PREFETCH_RADIUS * 8)
+
+PreviewWorker::PreviewWorker()
+    : stop(false), pendingCannon(), hasPending(false), backReady(false), requestedGeneration(0),
+    prefetchCenter(), prefetchWind(nullptr), prefetchIndex(N_PREFETCH_KEYS),
+    angleStep(PREVIEW_PREFETCH_ANGLE_STEP), v0Step(PREVIEW_PREFETCH_V0_STEP), cancel(false), buildTime(0.f), cacheHits(0), buffers(), front(0)
+{
+    thread = std::thread(&PreviewWorker::Run, this);
+}
+
+PreviewWorker::~PreviewWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        cancel = true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+unsigned int PreviewWorker::Request(const Cannon& cannon)
+{
+    // Off the key grid (default angle, typed value, set from code) the cached curve is an other shot
+    PreviewKey key = MakePreviewKey(cannon);
+    PreviewCurve cached;
+    bool hit = PreviewKeyExact(key, cannon) && cache.Find(key, cached);
+
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation = ++requestedGeneration;
+        // Cancels the running build (or prefetch), its result is stale now
+        cancel = true;
+
+        if (hit)
+        {
+            // The front buffer belongs to the UI thread
+            buffers[front] = cached;
+            buffers[front].generation = generation;
+            hasPending = false;
+            backReady = false;
+            cacheHits++;
+            Recenter(key, cannon.drag.wind);
+        }
+        else
+        {
+            pendingCannon = cannon;
+            hasPending = true;
+        }
+    }
+    condition.notify_one();
+    return generation;
+}
+
+bool PreviewWorker::Poll()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!backReady)
+        return false;
+
+    front = 1 - front;
+    backReady = false;
+    return true;
+}
+
+PreviewKey PreviewWorker::PrefetchKey(int index) const
+{
+    // A slider pixel is a fraction of quanta: d pixels away is one of the two keys around d steps
+    PreviewKey key = prefetchCenter;
+    int distance = index / 8 + 1;
+    int variant = index % 8;
+    float offset = (variant & 4 ? -distance : distance) * (variant & 2 ? v0Step : angleStep);
+    int quanta = (int)(variant & 1 ? ceilf(offset) : floorf(offset));
+    if (variant & 2)
+        key.v0 += quanta;
+    else
+        key.angle += quanta;
+    return key;
+}
+
+// Step of a slider: its changes between requests, averaged while the drag keeps its direction
+static void UpdatePrefetchStep(float& step, int change)
+{
+    step = (step > 0.f) == (change > 0) ? 0.5f * (step + change) : (float)change;
+}
+
+void PreviewWorker::Recenter(const PreviewKey& key, const WindField* wind)
+{
+    // Only a change of that slider alone is a drag step, signed so the keys ahead of the drag come first
+    PreviewKey angleMoved = prefetchCenter;
+    angleMoved.angle = key.angle;
+    PreviewKey v0Moved = prefetchCenter;
+    v0Moved.v0 = key.v0;
+    if (key.angle != prefetchCenter.angle && key == angleMoved)
+        UpdatePrefetchStep(angleStep, key.angle - prefetchCenter.angle);
+    if (key.v0 != prefetchCenter.v0 && key == v0Moved)
+        UpdatePrefetchStep(v0Step, key.v0 - prefetchCenter.v0);
+    prefetchCenter = key;
+    prefetchWind = wind;
+    prefetchIndex = 0;
+}
+
+void PreviewWorker::Run()
+{
+    PROFILE_THREAD_NAME("Preview worker");
+
+    while (true)
+    {
+        PreviewKey key;
+        Cannon cannon;
+        const WindField* wind = nullptr;
+        unsigned int generation;
+        PreviewCurve* back = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stop || hasPending || prefetchIndex < N_PREFETCH_KEYS; });
+            if (stop)
+                return;
+
+            generation = requestedGeneration;
+            cancel = false;
+            if (hasPending)
+            {
+                cannon = pendingCannon;
+                key = MakePreviewKey(cannon);
+                hasPending = false;
+
+                // The back buffer is ours again, an unread result is stale anyway
+                backReady = false;
+                back = &buffers[1 - front];
+            }
+            else
+            {
+                key = PrefetchKey(prefetchIndex++);
+                wind = prefetchWind;
+            }
+        }
+
+        // Speculative build of a neighbour, aborted by any new request
+        if (back == nullptr)
+        {
+            PROFILE_SCOPE("Prefetch preview");
+            PreviewCurve curve;
+            if (!cache.Contains(key) && BuildPreview(PreviewKeyCannon(key, wind), curve, cancel))
+                cache.Insert(key, curve);
+            continue;
+        }
+
+        // Exact parameters, only cached when they are the ones of the key
+        bool finished;
+        uint64_t buildStart = Profiler::Now();
+        {
+            PROFILE_SCOPE("Build preview");
+            finished = BuildPreview(cannon, *back, cancel);
+        }
+        buildTime = (Profiler::Now() - buildStart) / 1e6f;
+        back->generation = generation;
+        if (finished && PreviewKeyExact(key, cannon))
+            cache.Insert(key, *back);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished && generation == requestedGeneration)
+        {
+            backReady = true;
+            Recenter(key, cannon.drag.wind);
+        }
+    }
+}
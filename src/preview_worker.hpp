@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "preview.hpp"
+#include "preview_cache.hpp"
+
+// Number of Angle and Initial Speed slider steps prefetched on each side of the last request
+#define PREVIEW_PREFETCH_RADIUS 16
+// Prefetch step before any drag was seen, in key quanta: one pixel of a ~200 pixels wide slider
+// (Angle 0 to TAU / 4: 0.008 rad, Initial Speed 0 to 30: 0.15 m/s)
+#define PREVIEW_PREFETCH_ANGLE_STEP 8
+#define PREVIEW_PREFETCH_V0_STEP    150
+
+// Builds trajectory previews on a background thread
+// The UI keeps drawing the front buffer while the worker fills the back buffer.
+// A new request cancels the previous one, only the newest generation is ever published.
+// When idle, the worker fills the cache with the neighbouring Angle and Initial Speed values, a drag step apart.
+class PreviewWorker
+{
+public:
+    PreviewWorker();
+    ~PreviewWorker();
+
+    PreviewWorker(const PreviewWorker&) = delete;
+    PreviewWorker& operator=(const PreviewWorker&) = delete;
+
+    // Returns the generation of the request, a cached preview is published immediately
+    unsigned int Request(const Cannon& cannon);
+
+    // Swaps the newest finished preview in, returns true if Current() changed
+    bool Poll();
+
+    // Last completed preview, only changes on Poll
+    const PreviewCurve& Current() const { return buffers[front]; }
+
+    // Duration of the last (non speculative) build in ms
+    float LastBuildTime() const { return buildTime; }
+
+    // true until the newest request is published
+    bool IsPending() const { return Current().generation != requestedGeneration; }
+
+    // Requests served from the cache
+    int CacheHits() const { return cacheHits; }
+
+private:
+    void Run();
+    PreviewKey PrefetchKey(int index) const;
+    void Recenter(const PreviewKey& key, const WindField* wind);
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stop;
+
+    // Protected by mutex
+    Cannon pendingCannon;
+    bool hasPending;
+    bool backReady;            // Back buffer holds a finished curve the UI has not taken yet
+    unsigned int requestedGeneration;
+    PreviewKey prefetchCenter; // Last requested key
+    const WindField* prefetchWind; // Wind field of prefetchCenter
+    int prefetchIndex;         // Next neighbour to prefetch
+    float angleStep, v0Step;   // Change of each slider between two requests (key quanta), in the drag direction
+
+    PreviewCache cache;
+
+    std::atomic<bool> cancel;  // Raised when the running build is stale
+    std::atomic<float> buildTime;
+    std::atomic<int> cacheHits;
+    PreviewCurve buffers[2];
+    int front;
+};
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "profiler.hpp"
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Relaxed atomics: WriteChromeTrace may read a slot while its thread overwrites it, such a copy is dropped
+struct ProfileSlot
+{
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+};
+
+// Written by its thread only, read by WriteChromeTrace
+struct ProfileRing
+{
+    ProfileSlot events[PROFILER_RING_SIZE];
+    std::atomic<uint64_t> head; // Number of events ever recorded
+    const char* threadName;
+    int threadId;
+    ProfileRing* next;
+};
+
+// Rings are never freed, a trace can still show threads that are gone
+static std::atomic<ProfileRing*> rings(nullptr);
+static std::atomic<int> ringCount(0);
+static thread_local ProfileRing* threadRing = nullptr;
+
+static ProfileRing* GetThreadRing()
+{
+    if (threadRing != nullptr)
+        return threadRing;
+
+    ProfileRing* ring = new ProfileRing();
+    ring->head = 0;
+    ring->threadName = nullptr;
+    ring->threadId = ringCount++;
+
+    // Lock free push at the front of the list
+    ring->next = rings.load();
+    while (!rings.compare_exchange_weak(ring->next, ring))
+        ;
+
+    threadRing = ring;
+    return ring;
+}
+
+uint64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+    ProfileRing* ring = GetThreadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    // Orders the previous head store before the slot writes, a reader that sees them also sees that head
+    std::atomic_thread_fence(std::memory_order_release);
+    ProfileSlot& slot = ring->events[head % PROFILER_RING_SIZE];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    GetThreadRing()->threadName = name;
+}
+
+static void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*str >= 0x20)
+            fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+bool Profiler::WriteChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot write trace '%s'\n", path);
+        return false;
+    }
+
+    std::vector<ProfileEvent> events;
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+
+    for (ProfileRing* ring = rings.load(); ring != nullptr; ring = ring->next)
+    {
+        // Copy the ring, then drop what its thread may have overwritten meanwhile
+        uint64_t end = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = end > PROFILER_RING_SIZE ? end - PROFILER_RING_SIZE : 0;
+        events.clear();
+        for (uint64_t i = begin; i < end; i++)
+        {
+            const ProfileSlot& slot = ring->events[i % PROFILER_RING_SIZE];
+            events.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                slot.end.load(std::memory_order_relaxed) });
+        }
+
+        // The event headAfter may be half written in its slot, the one of event headAfter - PROFILER_RING_SIZE
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t headAfter = ring->head.load(std::memory_order_relaxed) + 1;
+        size_t skip = 0;
+        if (headAfter > PROFILER_RING_SIZE && headAfter - PROFILER_RING_SIZE > begin)
+            skip = (size_t)(headAfter - PROFILER_RING_SIZE - begin);
+        skip = skip < events.size() ? skip : events.size();
+
+        if (ring->threadName != nullptr)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", ring->threadId);
+            WriteJsonString(file, ring->threadName);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        for (size_t i = skip; i < events.size(); i++)
+        {
+            const ProfileEvent& event = events[i];
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            WriteJsonString(file, event.name);
+            // Microseconds with nanosecond precision
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                ring->threadId, event.start / 1000.0, (event.end - event.start) / 1000.0);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(file);
+    return true;
+}
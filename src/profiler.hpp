@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Scoped zone profiler, enabled unless NDEBUG is defined (make CONFIG=release), PROFILER_ENABLED 0 or 1 overrides it
+// Each thread records its zones in its own ring buffer, WriteChromeTrace dumps them
+// in the Chrome Trace Event format (chrome://tracing, ui.perfetto.dev).
+#ifndef PROFILER_ENABLED
+#ifdef NDEBUG
+#define PROFILER_ENABLED 0
+#else
+#define PROFILER_ENABLED 1
+#endif
+#endif
+
+// Zones kept per thread, the oldest ones are overwritten
+#define PROFILER_RING_SIZE 16384
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
+
+class Profiler
+{
+public:
+    // Nanoseconds since an arbitrary origin
+    static uint64_t Now();
+
+    // name must stay valid until the trace is written (string literals)
+    static void Record(const char* name, uint64_t start, uint64_t end);
+    static void SetThreadName(const char* name);
+
+    // Returns false if the file cannot be written
+    static bool WriteChromeTrace(const char* path);
+};
+
+struct ProfileZone
+{
+    const char* name;
+    uint64_t start;
+
+    ProfileZone(const char* name) : name(name), start(Profiler::Now()) {}
+    ~ProfileZone() { Profiler::Record(name, start, Profiler::Now()); }
+};
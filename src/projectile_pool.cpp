@@ -0,0 +1,352 @@
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#include "calc.hpp"
+#include "flight.hpp"
+#include "projectile_pool.hpp"
+#include "profiler.hpp"
+#include "wind_field.hpp"
+
+ProjectilePool::ProjectilePool(int capacity)
+    : slots(capacity), projectiles(capacity), denseSlots(capacity), freeSlot(0), count(0), dragCount(0),
+    dragSettings(FlightIntegratorSettings()), dragX(capacity), dragY(capacity), windX(capacity), windY(capacity), motionEpoch(0.0), time(0.0)
+{
+    dragBatch.Resize(capacity);
+    motions.Reserve(capacity);
+    // At most one pending event per live projectile, killed ones leave theirs until it is due or compacted
+    events.reserve(2 * capacity);
+    Clear();
+}
+
+void ProjectilePool::Clear()
+{
+    // Dead handles stay stale: generations are kept
+    for (int i = 0; i < count; i++)
+        slots[denseSlots[i]].generation++;
+
+    int capacity = (int)slots.size();
+    for (int i = 0; i < capacity; i++)
+        slots[i].dense = i + 1 < capacity ? i + 1 : PROJECTILE_INVALID_INDEX;
+    freeSlot = capacity > 0 ? 0 : PROJECTILE_INVALID_INDEX;
+    count = 0;
+    dragCount = 0;
+    events.clear();
+    motions.Clear();
+    motionEpoch = time;
+}
+
+void ProjectilePool::Schedule(uint32_t slot, double eventTime)
+{
+    // Kill and respawn cycles pile up stale events: dropped when the heap is full instead of growing it.
+    // The live ones are at most capacity - 1 here, the compaction always makes room
+    if (events.size() == events.capacity())
+    {
+        events.erase(std::remove_if(events.begin(), events.end(),
+            [this](const Event& event) { return slots[event.slot].generation != event.generation; }), events.end());
+        std::make_heap(events.begin(), events.end());
+    }
+
+    events.push_back({ eventTime, slot, slots[slot].generation });
+    std::push_heap(events.begin(), events.end());
+}
+
+ProjectileHandle ProjectilePool::Spawn(const Trajectory& trajectory, float drag, float windScale)
+{
+    ProjectileHandle handle;
+    if (freeSlot == PROJECTILE_INVALID_INDEX)
+        return handle;
+
+    uint32_t index = freeSlot;
+    Slot& slot = slots[index];
+    freeSlot = slot.dense;
+    slot.dense = count;
+
+    PooledProjectile& projectile = projectiles[count];
+    projectile.trajectory   = trajectory;
+    projectile.phase        = ProjectilePhase::Barrel;
+    projectile.phaseStart   = time;
+    projectile.origin       = trajectory.p0;
+    projectile.velocity     = trajectory.direction * trajectory.v0;
+    projectile.acceleration = trajectory.direction * -GRAVITY;
+    projectile.drag         = drag;
+    projectile.windScale    = windScale;
+    denseSlots[count] = index;
+    motions.Add(Motion(projectile));
+    count++;
+
+    // A projectile too slow to leave the barrel ends back at the breech
+    Schedule(index, time + (trajectory.exits ? trajectory.exitTime : trajectory.impactTime));
+
+    handle.index = index;
+    handle.generation = slot.generation;
+    return handle;
+}
+
+void ProjectilePool::RemoveDense(uint32_t dense)
+{
+    // The last live projectile fills the hole
+    uint32_t last = count - 1;
+    uint32_t index = denseSlots[dense];
+    if (projectiles[dense].phase == ProjectilePhase::Drag)
+        dragCount--;
+    if (dense != last)
+    {
+        projectiles[dense] = projectiles[last];
+        denseSlots[dense] = denseSlots[last];
+        slots[denseSlots[dense]].dense = dense;
+    }
+    motions.Remove(dense);
+    count--;
+
+    Slot& slot = slots[index];
+    slot.generation++;
+    slot.dense = freeSlot;
+    freeSlot = index;
+}
+
+bool ProjectilePool::IsAlive(ProjectileHandle handle) const
+{
+    return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+}
+
+bool ProjectilePool::Kill(ProjectileHandle handle)
+{
+    if (!IsAlive(handle))
+        return false;
+
+    RemoveDense(slots[handle.index].dense);
+    return true;
+}
+
+PooledProjectile* ProjectilePool::Get(ProjectileHandle handle)
+{
+    if (!IsAlive(handle))
+        return nullptr;
+    return &projectiles[slots[handle.index].dense];
+}
+
+float2 ProjectilePool::Position(const PooledProjectile& projectile, float timeOffset) const
+{
+    float t = fmaxf((float)(time - projectile.phaseStart) + timeOffset, 0.f);
+    if (projectile.phase == ProjectilePhase::Drag)
+    {
+        if (projectile.step <= 0.f)
+            return projectile.origin;
+        BodyState start = { projectile.origin, projectile.velocity };
+        return HermitePosition(start, projectile.end, projectile.step, fminf(t / projectile.step, 1.f));
+    }
+    return projectile.origin + projectile.velocity * t + projectile.acceleration * (0.5f * t * t);
+}
+
+void ProjectilePool::Positions(float timeOffset, float* x, float* y) const
+{
+    EvaluateProjectiles(motions, (float)(time - motionEpoch) + timeOffset, x, y);
+}
+
+ProjectileMotion ProjectilePool::Motion(const PooledProjectile& projectile) const
+{
+    ProjectileMotion motion;
+    motion.origin   = projectile.origin;
+    motion.velocity = projectile.velocity;
+    motion.start    = (float)(projectile.phaseStart - motionEpoch);
+    if (projectile.phase != ProjectilePhase::Drag)
+    {
+        motion.acceleration = projectile.acceleration;
+        motion.jerk         = { 0.f, 0.f };
+        motion.duration     = FLT_MAX;
+        return motion;
+    }
+
+    // Hermite interpolation of the step in powers of t
+    float h = projectile.step;
+    motion.acceleration = { 0.f, 0.f };
+    motion.jerk         = { 0.f, 0.f };
+    motion.duration     = h;
+    if (h > 0.f)
+    {
+        float2 chord = (projectile.end.position - projectile.origin) / h;
+        motion.acceleration = (chord * 3.f - projectile.velocity * 2.f - projectile.end.velocity) * (2.f / h);
+        motion.jerk         = (projectile.velocity + projectile.end.velocity - chord * 2.f) * (6.f / (h * h));
+    }
+    return motion;
+}
+
+void ProjectilePool::UpdateMotion(uint32_t dense)
+{
+    motions.Set(dense, Motion(projectiles[dense]));
+}
+
+// Same acceleration as the DragModel, for a given wind
+static float2 DragAcceleration(float drag, float windScale, float2 velocity, float2 wind)
+{
+    float2 airSpeed = velocity - wind * windScale;
+    return float2{ 0.f, -GRAVITY } - airSpeed * (drag * length(airSpeed));
+}
+
+// DragModel of the pooled rounds for DormandPrince45::StepBatch, the wind of a stage is sampled for all of them at once
+struct PoolDragForce
+{
+    const PooledProjectile* projectiles;
+    const WindField* wind;
+    float* x;
+    float* y;
+    float* u;
+    float* v;
+
+    void operator()(const int* rounds, const BodyState* states, float2* accelerations, int n) const
+    {
+        if (wind != nullptr)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                x[i] = states[i].position.x;
+                y[i] = states[i].position.y;
+            }
+            wind->Sample(x, y, u, v, n);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            const PooledProjectile& projectile = projectiles[rounds[i]];
+            float2 w = wind != nullptr ? float2{ u[i], v[i] } : float2{ 0.f, 0.f };
+            accelerations[i] = DragAcceleration(projectile.drag, projectile.windScale, states[i].velocity, w);
+        }
+    }
+};
+
+int ProjectilePool::StepDrag(const WindField* wind)
+{
+    PROFILE_FUNCTION();
+    PoolDragForce force = { projectiles.data(), wind, dragX.data(), dragY.data(), windX.data(), windY.data() };
+    IntegrationStats stats = {};
+
+    // Rounds whose step ended before the pool time take the next one, until every step reaches it
+    while (true)
+    {
+        int n = 0;
+        for (int i = 0; i < count; i++)
+        {
+            PooledProjectile& projectile = projectiles[i];
+            if (projectile.phase != ProjectilePhase::Drag || projectile.landed || projectile.phaseStart + projectile.step > time)
+                continue;
+
+            projectile.phaseStart += projectile.step;
+            projectile.origin      = projectile.end.position;
+            projectile.velocity    = projectile.end.velocity;
+            dragBatch.bodies[n] = i;
+            dragBatch.states[n] = projectile.end;
+            dragBatch.k1[n]     = projectile.acceleration;
+            dragBatch.dt[n]     = projectile.nextStep;
+            n++;
+        }
+        if (n == 0)
+            break;
+
+        DormandPrince45::StepBatch(force, dragBatch, n, dragSettings, stats);
+        for (int k = 0; k < n; k++)
+        {
+            PooledProjectile& projectile = projectiles[dragBatch.bodies[k]];
+            projectile.end          = dragBatch.states[k];
+            projectile.step         = dragBatch.taken[k];
+            projectile.nextStep     = dragBatch.dt[k];
+            projectile.acceleration = dragBatch.k1[k];
+            if (projectile.end.position.y > GROUND_HEIGHT)
+            {
+                UpdateMotion(dragBatch.bodies[k]);
+                continue;
+            }
+
+            // Contact inside the step, as IntegrateFlight locates it: the step is cut there.
+            // The Hermite interpolation of the cut step is the same cubic restricted to it
+            BodyState start = { projectile.origin, projectile.velocity };
+            float s = GroundContact(start, projectile.end, projectile.step);
+            projectile.end      = { HermitePosition(start, projectile.end, projectile.step, s), HermiteVelocity(start, projectile.end, projectile.step, s) };
+            projectile.end.position.y = GROUND_HEIGHT;
+            projectile.step    *= s;
+            projectile.landed   = true;
+            UpdateMotion(dragBatch.bodies[k]);
+            if (projectile.phaseStart + projectile.step > time)
+                Schedule(denseSlots[dragBatch.bodies[k]], projectile.phaseStart + projectile.step);
+        }
+    }
+
+    // Contacts already past die now, the others on their event. Backwards, the round moved into a removed entry was already checked
+    int impacts = 0;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        const PooledProjectile& projectile = projectiles[i];
+        if (projectile.phase == ProjectilePhase::Drag && projectile.landed && projectile.phaseStart + projectile.step <= time)
+        {
+            RemoveDense(i);
+            impacts++;
+        }
+    }
+    return impacts;
+}
+
+int ProjectilePool::Step(float dt, const WindField* wind)
+{
+    PROFILE_FUNCTION();
+    time += dt;
+
+    // The motions start from a recent epoch, float times stay below a minute
+    if (time - motionEpoch > 64.0)
+    {
+        motionEpoch = time;
+        for (int i = 0; i < count; i++)
+            motions.start[i] = (float)(projectiles[i].phaseStart - motionEpoch);
+    }
+
+    // Only the projectiles with a due event are touched
+    int impacts = 0;
+    while (!events.empty() && events.front().time <= time)
+    {
+        Event event = events.front();
+        std::pop_heap(events.begin(), events.end());
+        events.pop_back();
+
+        // Killed (and maybe reused) since it was scheduled
+        if (slots[event.slot].generation != event.generation)
+            continue;
+
+        PooledProjectile& projectile = projectiles[slots[event.slot].dense];
+        if (projectile.phase == ProjectilePhase::Barrel && projectile.trajectory.exits && projectile.drag > 0.f)
+        {
+            // Stepped from the exact exit time by StepDrag, an empty first step ending there
+            const Trajectory& trajectory = projectile.trajectory;
+            float2 w = wind != nullptr ? wind->Sample(trajectory.exitPoint) : float2{ 0.f, 0.f };
+            projectile.phase        = ProjectilePhase::Drag;
+            projectile.phaseStart   = event.time;
+            projectile.origin       = trajectory.exitPoint;
+            projectile.velocity     = trajectory.exitSpeed;
+            projectile.acceleration = DragAcceleration(projectile.drag, projectile.windScale, trajectory.exitSpeed, w);
+            projectile.end          = { trajectory.exitPoint, trajectory.exitSpeed };
+            projectile.step         = 0.f;
+            projectile.nextStep     = dragSettings.step;
+            projectile.landed       = false;
+            UpdateMotion(slots[event.slot].dense);
+            dragCount++;
+        }
+        else if (projectile.phase == ProjectilePhase::Barrel && projectile.trajectory.exits)
+        {
+            // Free flight from the exact exit time
+            const Trajectory& trajectory = projectile.trajectory;
+            projectile.phase        = ProjectilePhase::Ballistic;
+            projectile.phaseStart   = event.time;
+            projectile.origin       = trajectory.exitPoint;
+            projectile.velocity     = trajectory.exitSpeed;
+            projectile.acceleration = { 0.f, -GRAVITY };
+            UpdateMotion(slots[event.slot].dense);
+            Schedule(event.slot, event.time + (trajectory.impactTime - trajectory.exitTime));
+        }
+        else
+        {
+            RemoveDense(slots[event.slot].dense);
+            impacts++;
+        }
+    }
+
+    if (dragCount > 0)
+        impacts += StepDrag(wind);
+    return impacts;
+}
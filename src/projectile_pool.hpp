@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "integrators.hpp"
+#include "projectile_soa.hpp"
+#include "simulation.hpp"
+
+#define PROJECTILE_INVALID_INDEX 0xFFFFFFFFu
+
+// Reference to a pooled projectile, it becomes stale (not an other projectile) once the projectile died
+struct ProjectileHandle
+{
+    uint32_t index = PROJECTILE_INVALID_INDEX; // Slot
+    uint32_t generation = 0;                   // Generation of the slot when the projectile was spawned
+
+    bool IsValid() const { return index != PROJECTILE_INVALID_INDEX; }
+};
+
+enum class ProjectilePhase : uint32_t
+{
+    Barrel,    // Decelerating along the barrel, until the barrel exit (or back to the breech)
+    Ballistic, // Free flight, until the ground
+    Drag,      // Free flight under air drag (and wind), integrated by steps of the flight path integrator until the ground
+};
+
+// Round in flight
+// Within a phase the motion is one quadratic: position = origin + velocity * t + acceleration * t^2 / 2, t since phaseStart
+// Phase changes happen at exact times scheduled in the pool event queue, nothing is tested per tick
+// except for the rounds under air drag: they take the adaptive Dormand-Prince steps of the flight path
+// (FlightIntegratorSettings), so a salvo lands where the preview shows. Within a step the motion is the cubic Hermite
+// interpolation of its end states, from (origin, velocity) at phaseStart to end after step seconds
+struct PooledProjectile
+{
+    float2 origin;
+    float2 velocity;
+    float2 acceleration;   // Drag: acceleration at the end of the step, the first stage of the next one
+    double phaseStart;     // Pool time
+    ProjectilePhase phase;
+    float drag;            // k of the DragModel, 0 for a round flying in vacuum
+    float windScale;
+    BodyState end;         // Drag: end of the current step, the ground contact once landed
+    float step;            // Drag: length of the current step (s)
+    float nextStep;        // Drag: step the integrator tries next (s)
+    bool landed;           // Drag: the current step ends on the ground, the round dies at its end
+    Trajectory trajectory;
+};
+
+// Fixed capacity pool of projectiles
+// Slots give stable indices to the handles, the live projectiles are packed at the start of a dense array
+// so rendering only goes through live data. Nothing is allocated after the constructor.
+class ProjectilePool
+{
+public:
+    ProjectilePool(int capacity);
+
+    // Invalid handle when the pool is full, the projectile is launched at the current pool time
+    // With drag > 0 (k of the DragModel) the round leaves the closed form at the barrel exit
+    ProjectileHandle Spawn(const Trajectory& trajectory, float drag = 0.f, float windScale = 1.f);
+    bool Kill(ProjectileHandle handle);
+    void Clear();
+
+    // nullptr if the projectile died, the pointer is only valid until the next Spawn/Kill/Step
+    PooledProjectile* Get(ProjectileHandle handle);
+    bool IsAlive(ProjectileHandle handle) const;
+
+    // Advances the pool time and fires the due events (barrel exits, impacts). Returns the number of impacts
+    // The rounds under drag whose step ended take their next one, all together: each stage samples the wind
+    // at all of their positions in one batch
+    int Step(float dt, const WindField* wind = nullptr);
+
+    // Position timeOffset seconds away from the pool time (within the current phase, or step under drag)
+    float2 Position(const PooledProjectile& projectile, float timeOffset = 0.f) const;
+    // Same for every live projectile, in the order of Data(): x and y receive Count() floats
+    // Evaluated 8 or 16 rounds at a time from the closed form motions kept in a structure of arrays
+    void Positions(float timeOffset, float* x, float* y) const;
+    double Time() const { return time; }
+
+    // Live projectiles, Count() packed entries
+    const PooledProjectile* Data() const { return projectiles.data(); }
+    int Count() const { return count; }
+    int Capacity() const { return (int)slots.size(); }
+
+private:
+    struct Slot
+    {
+        uint32_t generation;
+        uint32_t dense; // Index in projectiles while alive, next free slot otherwise
+    };
+
+    // Next phase change of a projectile, stale once the slot generation changed
+    struct Event
+    {
+        double time;
+        uint32_t slot;
+        uint32_t generation;
+
+        // Earliest event on top of the heap
+        bool operator<(const Event& other) const { return time > other.time; }
+    };
+
+    void Schedule(uint32_t slot, double eventTime);
+    ProjectileMotion Motion(const PooledProjectile& projectile) const;
+    void UpdateMotion(uint32_t dense);
+    void RemoveDense(uint32_t dense);
+    int StepDrag(const WindField* wind);
+
+    std::vector<Slot> slots;
+    std::vector<PooledProjectile> projectiles; // [0, count) are alive
+    std::vector<uint32_t> denseSlots;          // Slot of each dense entry
+    std::vector<Event> events;                 // Binary heap
+    uint32_t freeSlot;                         // Head of the free list
+    int count;
+    int dragCount;                             // Live rounds in the Drag phase
+
+    // Rounds under drag stepped together and the wind at their stage positions, sized for the whole pool
+    IntegratorSettings dragSettings;
+    DormandPrince45Batch dragBatch;
+    std::vector<float> dragX, dragY, windX, windY;
+    // Motion of each dense entry, started motionEpoch seconds into the pool time to keep float times small
+    ProjectileSoA motions;
+    double motionEpoch;
+    double time;
+};
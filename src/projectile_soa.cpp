@@ -0,0 +1,222 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <new>
+
+#include "projectile_soa.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows any intrinsic without target flags, gcc/clang need the attribute on the function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define N_SOA_ARRAYS 10
+
+ProjectileSoA::ProjectileSoA()
+    : x(nullptr), y(nullptr), vx(nullptr), vy(nullptr), ax(nullptr), ay(nullptr), jx(nullptr), jy(nullptr),
+    start(nullptr), duration(nullptr), count(0), capacity(0), memory(nullptr)
+{
+}
+
+ProjectileSoA::~ProjectileSoA()
+{
+    free(memory);
+}
+
+void ProjectileSoA::Reserve(int newCapacity)
+{
+    newCapacity = (newCapacity + PROJECTILE_SOA_WIDTH - 1) & ~(PROJECTILE_SOA_WIDTH - 1);
+    if (newCapacity <= capacity)
+        return;
+
+    // One block for all the arrays, PROJECTILE_SOA_WIDTH floats is a multiple of the alignment
+    size_t arraySize = newCapacity * sizeof(float);
+    void* newMemory = malloc(arraySize * N_SOA_ARRAYS + PROJECTILE_SOA_ALIGN);
+    if (newMemory == nullptr)
+        throw std::bad_alloc(); // Like a std::vector, the store keeps its previous arrays
+    float* base = (float*)(((uintptr_t)newMemory + PROJECTILE_SOA_ALIGN - 1) & ~(uintptr_t)(PROJECTILE_SOA_ALIGN - 1));
+    memset(base, 0, arraySize * N_SOA_ARRAYS);
+
+    float** arrays[N_SOA_ARRAYS] = { &x, &y, &vx, &vy, &ax, &ay, &jx, &jy, &start, &duration };
+    for (int i = 0; i < N_SOA_ARRAYS; i++)
+    {
+        float* array = base + i * newCapacity;
+        if (count > 0)
+            memcpy(array, *arrays[i], count * sizeof(float));
+        *arrays[i] = array;
+    }
+
+    free(memory);
+    memory = newMemory;
+    capacity = newCapacity;
+}
+
+void ProjectileSoA::Clear()
+{
+    // Keep padding lanes at zero so kernels never evaluate garbage
+    if (capacity > 0)
+        memset(x, 0, capacity * sizeof(float) * N_SOA_ARRAYS);
+    count = 0;
+}
+
+int ProjectileSoA::Add(const ProjectileMotion& motion)
+{
+    if (count == capacity)
+        Reserve(capacity == 0 ? PROJECTILE_SOA_WIDTH : capacity * 2);
+
+    int index = count++;
+    Set(index, motion);
+    return index;
+}
+
+void ProjectileSoA::Set(int index, const ProjectileMotion& motion)
+{
+    x[index]        = motion.origin.x;
+    y[index]        = motion.origin.y;
+    vx[index]       = motion.velocity.x;
+    vy[index]       = motion.velocity.y;
+    ax[index]       = motion.acceleration.x;
+    ay[index]       = motion.acceleration.y;
+    jx[index]       = motion.jerk.x;
+    jy[index]       = motion.jerk.y;
+    start[index]    = motion.start;
+    duration[index] = motion.duration;
+}
+
+void ProjectileSoA::Remove(int index)
+{
+    int last = --count;
+    float* arrays[N_SOA_ARRAYS] = { x, y, vx, vy, ax, ay, jx, jy, start, duration };
+    for (int i = 0; i < N_SOA_ARRAYS; i++)
+    {
+        arrays[i][index] = arrays[i][last];
+        arrays[i][last] = 0.f;
+    }
+}
+
+// Horner form of the cubic: origin + t * (velocity + t * (acceleration / 2 + t * jerk / 6))
+static void EvaluateScalar(const ProjectileSoA& s, int first, int end, float time, float* outX, float* outY)
+{
+    for (int i = first; i < end; i++)
+    {
+        float t = fminf(fmaxf(time - s.start[i], 0.f), s.duration[i]);
+        outX[i] = s.x[i] + t * (s.vx[i] + t * (s.ax[i] * 0.5f + t * (s.jx[i] * (1.f / 6.f))));
+        outY[i] = s.y[i] + t * (s.vy[i] + t * (s.ay[i] * 0.5f + t * (s.jy[i] * (1.f / 6.f))));
+    }
+}
+
+#if defined(SIMD_X86)
+// The kernels only write whole vectors of the output: the last partial one is left to the scalar path
+static void EvaluateSSE(const ProjectileSoA& s, int n, float time, float* outX, float* outY)
+{
+    __m128 now   = _mm_set1_ps(time);
+    __m128 zero  = _mm_setzero_ps();
+    __m128 half  = _mm_set1_ps(0.5f);
+    __m128 sixth = _mm_set1_ps(1.f / 6.f);
+    for (int i = 0; i < n; i += 4)
+    {
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_sub_ps(now, _mm_load_ps(s.start + i)), zero), _mm_load_ps(s.duration + i));
+        __m128 x = _mm_mul_ps(_mm_load_ps(s.jx + i), sixth);
+        x = _mm_add_ps(_mm_mul_ps(_mm_load_ps(s.ax + i), half), _mm_mul_ps(t, x));
+        x = _mm_add_ps(_mm_load_ps(s.vx + i), _mm_mul_ps(t, x));
+        x = _mm_add_ps(_mm_load_ps(s.x + i), _mm_mul_ps(t, x));
+        __m128 y = _mm_mul_ps(_mm_load_ps(s.jy + i), sixth);
+        y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(s.ay + i), half), _mm_mul_ps(t, y));
+        y = _mm_add_ps(_mm_load_ps(s.vy + i), _mm_mul_ps(t, y));
+        y = _mm_add_ps(_mm_load_ps(s.y + i), _mm_mul_ps(t, y));
+        _mm_storeu_ps(outX + i, x);
+        _mm_storeu_ps(outY + i, y);
+    }
+}
+
+TARGET("avx2,fma")
+static void EvaluateAVX2(const ProjectileSoA& s, int n, float time, float* outX, float* outY)
+{
+    __m256 now   = _mm256_set1_ps(time);
+    __m256 zero  = _mm256_setzero_ps();
+    __m256 half  = _mm256_set1_ps(0.5f);
+    __m256 sixth = _mm256_set1_ps(1.f / 6.f);
+    for (int i = 0; i < n; i += 8)
+    {
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(now, _mm256_load_ps(s.start + i)), zero), _mm256_load_ps(s.duration + i));
+        __m256 x = _mm256_mul_ps(_mm256_load_ps(s.jx + i), sixth);
+        x = _mm256_fmadd_ps(t, x, _mm256_mul_ps(_mm256_load_ps(s.ax + i), half));
+        x = _mm256_fmadd_ps(t, x, _mm256_load_ps(s.vx + i));
+        x = _mm256_fmadd_ps(t, x, _mm256_load_ps(s.x + i));
+        __m256 y = _mm256_mul_ps(_mm256_load_ps(s.jy + i), sixth);
+        y = _mm256_fmadd_ps(t, y, _mm256_mul_ps(_mm256_load_ps(s.ay + i), half));
+        y = _mm256_fmadd_ps(t, y, _mm256_load_ps(s.vy + i));
+        y = _mm256_fmadd_ps(t, y, _mm256_load_ps(s.y + i));
+        _mm256_storeu_ps(outX + i, x);
+        _mm256_storeu_ps(outY + i, y);
+    }
+}
+
+// gcc headers implement the unmasked AVX-512 intrinsics with an undefined pass-through operand
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+TARGET("avx512f")
+static void EvaluateAVX512(const ProjectileSoA& s, int n, float time, float* outX, float* outY)
+{
+    __m512 now   = _mm512_set1_ps(time);
+    __m512 zero  = _mm512_setzero_ps();
+    __m512 half  = _mm512_set1_ps(0.5f);
+    __m512 sixth = _mm512_set1_ps(1.f / 6.f);
+    for (int i = 0; i < n; i += 16)
+    {
+        __m512 t = _mm512_min_ps(_mm512_max_ps(_mm512_sub_ps(now, _mm512_load_ps(s.start + i)), zero), _mm512_load_ps(s.duration + i));
+        __m512 x = _mm512_mul_ps(_mm512_load_ps(s.jx + i), sixth);
+        x = _mm512_fmadd_ps(t, x, _mm512_mul_ps(_mm512_load_ps(s.ax + i), half));
+        x = _mm512_fmadd_ps(t, x, _mm512_load_ps(s.vx + i));
+        x = _mm512_fmadd_ps(t, x, _mm512_load_ps(s.x + i));
+        __m512 y = _mm512_mul_ps(_mm512_load_ps(s.jy + i), sixth);
+        y = _mm512_fmadd_ps(t, y, _mm512_mul_ps(_mm512_load_ps(s.ay + i), half));
+        y = _mm512_fmadd_ps(t, y, _mm512_load_ps(s.vy + i));
+        y = _mm512_fmadd_ps(t, y, _mm512_load_ps(s.y + i));
+        _mm512_storeu_ps(outX + i, x);
+        _mm512_storeu_ps(outY + i, y);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+void EvaluateProjectiles(const ProjectileSoA& store, float time, float* x, float* y, SimdLevel level)
+{
+    int count = store.Count();
+    int width = level == SimdLevel::AVX512 ? 16 : level == SimdLevel::AVX2 ? 8 : level == SimdLevel::SSE ? 4 : 1;
+    int whole = count / width * width;
+
+    switch (level)
+    {
+#if defined(SIMD_X86)
+    case SimdLevel::SSE:    EvaluateSSE(store, whole, time, x, y);    break;
+    case SimdLevel::AVX2:   EvaluateAVX2(store, whole, time, x, y);   break;
+    case SimdLevel::AVX512: EvaluateAVX512(store, whole, time, x, y); break;
+#endif
+    default:                whole = 0;                                break;
+    }
+    EvaluateScalar(store, whole, count, time, x, y);
+}
+
+void EvaluateProjectiles(const ProjectileSoA& store, float time, float* x, float* y)
+{
+    static const SimdLevel level = DetectSimdLevel();
+    EvaluateProjectiles(store, time, x, y, level);
+}
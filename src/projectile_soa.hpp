@@ -0,0 +1,69 @@
+#pragma once
+
+#include "simd.hpp"
+#include "types.hpp"
+
+// Every array of the store starts on a 64 bytes boundary and is padded to 16 floats (one AVX-512 register)
+#define PROJECTILE_SOA_ALIGN 64
+#define PROJECTILE_SOA_WIDTH 16
+
+// Closed form motion of a projectile, t = time - start clamped to [0, duration]:
+// position = origin + velocity * t + acceleration * t^2 / 2 + jerk * t^3 / 6
+// A constant acceleration phase (UpdateProjectile, the pooled barrel and ballistic phases) has no jerk and no end,
+// a step of the flight integrator is its cubic Hermite interpolation over the step
+struct ProjectileMotion
+{
+    float2 origin;
+    float2 velocity;
+    float2 acceleration;
+    float2 jerk;
+    float start;
+    float duration;
+};
+
+// Structure of arrays projectile container, used to evaluate the closed form of many projectiles at once
+// ProjectilePool keeps the motion of its live rounds in one, in the same order as its dense array,
+// and the renderer gets all the positions of a salvo from EvaluateProjectiles
+class ProjectileSoA
+{
+public:
+    ProjectileSoA();
+    ~ProjectileSoA();
+
+    ProjectileSoA(const ProjectileSoA&) = delete;
+    ProjectileSoA& operator=(const ProjectileSoA&) = delete;
+
+    void Reserve(int newCapacity);
+    void Clear();
+
+    // Returns the index of the new projectile
+    int Add(const ProjectileMotion& motion);
+    void Set(int index, const ProjectileMotion& motion);
+    // The last projectile takes the index
+    void Remove(int index);
+
+    int Count() const { return count; }
+    // Count rounded up to PROJECTILE_SOA_WIDTH, kernels can process this many elements without remainder loop
+    int PaddedCount() const { return (count + PROJECTILE_SOA_WIDTH - 1) & ~(PROJECTILE_SOA_WIDTH - 1); }
+
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+    float* ax;
+    float* ay;
+    float* jx;
+    float* jy;
+    float* start;
+    float* duration;
+
+private:
+    int count;
+    int capacity;
+    void* memory;
+};
+
+// Positions of every projectile of the store at the given time, x and y receive Count() floats
+void EvaluateProjectiles(const ProjectileSoA& store, float time, float* x, float* y);
+// Same, forcing a code path (must be supported by the CPU)
+void EvaluateProjectiles(const ProjectileSoA& store, float time, float* x, float* y, SimdLevel level);
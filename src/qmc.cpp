@@ -0,0 +1,169 @@
+#include <math.h>
+
+#include "qmc.hpp"
+
+#define SOBOL_BITS 32
+
+// Primitive polynomial (degree s, coefficients a) and initial direction numbers m of each dimension after the first
+struct SobolPolynomial
+{
+    int s;
+    uint32_t a;
+    uint32_t m[5];
+};
+
+static const SobolPolynomial sobolPolynomials[QMC_DIMENSIONS - 1] =
+{
+    { 1, 0, { 1 } },
+    { 2, 1, { 1, 3 } },
+    { 3, 1, { 1, 3, 1 } },
+    { 3, 2, { 1, 1, 1 } },
+    { 4, 1, { 1, 1, 3, 3 } },
+    { 4, 4, { 1, 3, 5, 13 } },
+    { 5, 2, { 1, 1, 5, 5, 17 } },
+};
+
+// Direction numbers, and their xor for every value of each byte of the index
+struct SobolDirections
+{
+    uint32_t v[QMC_DIMENSIONS][SOBOL_BITS];
+    uint32_t bytes[QMC_DIMENSIONS][4][256];
+
+    SobolDirections()
+    {
+        // First dimension: van der Corput sequence in base 2
+        for (int k = 0; k < SOBOL_BITS; k++)
+            v[0][k] = 1u << (31 - k);
+
+        for (int d = 1; d < QMC_DIMENSIONS; d++)
+        {
+            const SobolPolynomial& polynomial = sobolPolynomials[d - 1];
+            int s = polynomial.s;
+            for (int k = 0; k < s; k++)
+                v[d][k] = polynomial.m[k] << (31 - k);
+            for (int k = s; k < SOBOL_BITS; k++)
+            {
+                uint32_t direction = v[d][k - s] ^ (v[d][k - s] >> s);
+                for (int j = 1; j < s; j++)
+                {
+                    if ((polynomial.a >> (s - 1 - j)) & 1)
+                        direction ^= v[d][k - j];
+                }
+                v[d][k] = direction;
+            }
+        }
+
+        for (int d = 0; d < QMC_DIMENSIONS; d++)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                for (uint32_t value = 0; value < 256; value++)
+                {
+                    uint32_t bits = 0;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        if (value & (1u << k))
+                            bits ^= v[d][b * 8 + k];
+                    }
+                    bytes[d][b][value] = bits;
+                }
+            }
+        }
+    }
+};
+
+static const SobolDirections& Sobol()
+{
+    static const SobolDirections directions;
+    return directions;
+}
+
+uint32_t SobolBits(uint32_t index, int dimension)
+{
+    // Xor of the direction numbers of the index bits, a byte at a time
+    const uint32_t (*bytes)[256] = Sobol().bytes[dimension];
+    return bytes[0][index & 0xFF] ^ bytes[1][(index >> 8) & 0xFF] ^ bytes[2][(index >> 16) & 0xFF] ^ bytes[3][index >> 24];
+}
+
+static inline uint32_t ReverseBits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+uint32_t OwenScramble(uint32_t bits, uint32_t seed)
+{
+    // Laine-Karras style permutation on the reversed bits: each bit only depends on the more significant ones
+    uint32_t x = ReverseBits(bits);
+    x ^= x * 0x3D20ADEAu;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526C56u;
+    x ^= x * 0x53A22864u;
+    return ReverseBits(x);
+}
+
+// Digits reversed in an integer, a single conversion at the end; a constant base turns the divisions into multiplies
+template<uint32_t base>
+static uint32_t RadicalInverse(uint32_t index)
+{
+    uint64_t reversed = 0, scale = 1;
+    for (; index != 0; index /= base)
+    {
+        reversed = reversed * base + index % base;
+        scale *= base;
+    }
+    return (uint32_t)((double)reversed / (double)scale * 4294967296.0);
+}
+
+uint32_t HaltonBits(uint32_t index, int dimension)
+{
+    switch (dimension)
+    {
+    case 0: return RadicalInverse<2>(index);
+    case 1: return RadicalInverse<3>(index);
+    case 2: return RadicalInverse<5>(index);
+    case 3: return RadicalInverse<7>(index);
+    case 4: return RadicalInverse<11>(index);
+    case 5: return RadicalInverse<13>(index);
+    case 6: return RadicalInverse<17>(index);
+    default: return RadicalInverse<19>(index);
+    }
+}
+
+float BitsToUniform(uint32_t bits)
+{
+    // 23 bits: the centered value of the last interval, 1 - 2^-24, is still below 1 in float
+    return ((bits >> 9) + 0.5f) * (1.f / 8388608.f);
+}
+
+float InverseNormal(float u)
+{
+    static const double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+        1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+        6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+        -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+        3.754408661907416e+00 };
+    const double low = 0.02425;
+
+    double p = u;
+    if (p < low || p > 1.0 - low)
+    {
+        // Tails: rational function of sqrt(-2 log(p)), odd symmetry for the upper one
+        double q = sqrt(-2.0 * log(p < low ? p : 1.0 - p));
+        double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        return (float)(p < low ? x : -x);
+    }
+
+    double q = p - 0.5;
+    double r = q * q;
+    return (float)((((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+        (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0));
+}
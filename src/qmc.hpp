@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Quasi-Monte Carlo points: low-discrepancy sequences cover the unit cube evenly, the error of a smooth integrand
+// drops like ~(log N)^d / N instead of 1 / sqrt(N) with random points.
+// Coordinates are 32 bits fractions so the randomizations stay exact integer operations.
+
+// Dimensions with Sobol direction numbers (Joe and Kuo, new-joe-kuo-6.21201) and Halton bases
+#define QMC_DIMENSIONS 8
+
+// Coordinate of a point of the Sobol sequence
+uint32_t SobolBits(uint32_t index, int dimension);
+// Nested uniform (Owen) scrambling, hash-based (Burley, "Practical hash-based Owen scrambling"): the scrambled
+// points keep the stratification of the sequence and each one is uniformly distributed
+uint32_t OwenScramble(uint32_t bits, uint32_t seed);
+
+// Coordinate of a point of the Halton sequence: radical inverse of the index in the prime base of the dimension
+// Randomized by adding a shift modulo 1 (Cranley-Patterson rotation), a wrapping add on the fraction
+uint32_t HaltonBits(uint32_t index, int dimension);
+
+// Uniform in (0, 1): 23 bits of the fraction, centered in their interval so the inverse CDF stays finite
+float BitsToUniform(uint32_t bits);
+// Inverse of the standard normal CDF (Acklam, relative error below 1.2e-9 before the rounding to float)
+// Unlike a rejection method it maps the points one to one and keeps their stratification
+float InverseNormal(float u);
@@ -0,0 +1,390 @@
+#include <math.h>
+
+#include "random.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic without target flags, gcc/clang need the attribute on the function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// Last word of the counter: (attempt << 2) | kind
+#define KIND_NORMAL  0u
+#define KIND_UNIFORM 1u
+#define KIND_TAIL    2u
+
+#define ZIGGURAT_LAYERS 128
+#define ZIGGURAT_R 3.442619855899
+
+void Philox4x32(const uint32_t counter[4], uint64_t key, uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        uint64_t product0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t product1 = (uint64_t)PHILOX_M1 * c2;
+        c0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)product1;
+        c2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)product0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+static inline float ToUniform(uint32_t bits)
+{
+    return ((bits >> 8) + 1) * (1.f / 16777216.f);
+}
+
+// Marsaglia and Tsang ziggurat: layer i accepts |hz| < k[i] as hz * w[i] without looking at the curve
+struct ZigguratTables
+{
+    int32_t k[ZIGGURAT_LAYERS];
+    float w[ZIGGURAT_LAYERS];
+    float f[ZIGGURAT_LAYERS];
+
+    ZigguratTables()
+    {
+        const double m1 = 2147483648.0;
+        const double v = 9.91256303526217e-3; // Area of a layer
+        double dn = ZIGGURAT_R, tn = dn;
+        double q = v / exp(-0.5 * dn * dn);
+        k[0] = (int32_t)((dn / q) * m1);
+        k[1] = 0;
+        w[0] = (float)(q / m1);
+        w[ZIGGURAT_LAYERS - 1] = (float)(dn / m1);
+        f[0] = 1.f;
+        f[ZIGGURAT_LAYERS - 1] = (float)exp(-0.5 * dn * dn);
+        for (int i = ZIGGURAT_LAYERS - 2; i >= 1; i--)
+        {
+            dn = sqrt(-2.0 * log(v / dn + exp(-0.5 * dn * dn)));
+            k[i + 1] = (int32_t)((dn / tn) * m1);
+            tn = dn;
+            f[i] = (float)exp(-0.5 * dn * dn);
+            w[i] = (float)(dn / m1);
+        }
+    }
+};
+
+static const ZigguratTables& Ziggurat()
+{
+    static const ZigguratTables tables;
+    return tables;
+}
+
+// |hz| wrapping like the SIMD abs: INT32_MIN stays negative
+static inline int32_t Abs32(int32_t hz)
+{
+    return (int32_t)(hz < 0 ? 0u - (uint32_t)hz : (uint32_t)hz);
+}
+
+uint32_t RandomBits(uint64_t seed, uint64_t sample, uint32_t draw)
+{
+    uint32_t counter[4] = { (uint32_t)sample, (uint32_t)(sample >> 32), draw, KIND_UNIFORM };
+    uint32_t out[4];
+    Philox4x32(counter, seed, out);
+    return out[0];
+}
+
+float RandomUniform(uint64_t seed, uint64_t sample, uint32_t draw)
+{
+    return ToUniform(RandomBits(seed, sample, draw));
+}
+
+float RandomNormal(uint64_t seed, uint64_t sample, uint32_t draw)
+{
+    const ZigguratTables& z = Ziggurat();
+    for (uint32_t attempt = 0; ; attempt++)
+    {
+        // Words: value, layer, then two uniforms for the rare rejection test
+        uint32_t counter[4] = { (uint32_t)sample, (uint32_t)(sample >> 32), draw, (attempt << 2) | KIND_NORMAL };
+        uint32_t out[4];
+        Philox4x32(counter, seed, out);
+        int32_t hz = (int32_t)out[0];
+        int iz = out[1] & (ZIGGURAT_LAYERS - 1);
+        float x = (float)hz * z.w[iz];
+        if (Abs32(hz) < z.k[iz])
+            return x;
+
+        if (iz == 0)
+        {
+            // Tail beyond R, Marsaglia's method: two uniforms per try, two tries per block
+            const float r = (float)ZIGGURAT_R;
+            for (uint32_t tail = 0; ; tail++)
+            {
+                uint32_t tailCounter[4] = { (uint32_t)sample, (uint32_t)(sample >> 32), draw, (tail << 2) | KIND_TAIL };
+                uint32_t words[4];
+                Philox4x32(tailCounter, seed, words);
+                for (int i = 0; i < 4; i += 2)
+                {
+                    float tx = -logf(ToUniform(words[i])) / r;
+                    float ty = -logf(ToUniform(words[i + 1]));
+                    if (ty + ty >= tx * tx)
+                        return hz > 0 ? r + tx : -r - tx;
+                }
+            }
+        }
+
+        // Wedge between the layer rectangle and the curve, a new layer otherwise
+        if (z.f[iz] + ToUniform(out[2]) * (z.f[iz - 1] - z.f[iz]) < expf(-0.5f * x * x))
+            return x;
+    }
+}
+
+static void SampleCounters(uint64_t firstSample, int count, uint32_t* low, uint32_t* high)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t sample = firstSample + i;
+        low[i] = (uint32_t)sample;
+        high[i] = (uint32_t)(sample >> 32);
+    }
+}
+
+#if defined(SIMD_X86)
+TARGET("avx2")
+static inline __m256i MulHiAVX2(__m256i a, __m256i m)
+{
+    // 32x32 -> 64 bits products of the even lanes, then of the odd ones
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+TARGET("avx2")
+static void PhiloxAVX2(__m256i c[4], uint64_t key)
+{
+    __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+    __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        __m256i hi0 = MulHiAVX2(c[0], m0);
+        __m256i lo0 = _mm256_mullo_epi32(c[0], m0);
+        __m256i hi1 = MulHiAVX2(c[2], m1);
+        __m256i lo1 = _mm256_mullo_epi32(c[2], m1);
+        c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]), _mm256_set1_epi32((int)k0));
+        c[1] = lo1;
+        c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]), _mm256_set1_epi32((int)k1));
+        c[3] = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+TARGET("avx2")
+static inline __m256 ToUniformAVX2(__m256i bits)
+{
+    __m256i mantissa = _mm256_add_epi32(_mm256_srli_epi32(bits, 8), _mm256_set1_epi32(1));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(mantissa), _mm256_set1_ps(1.f / 16777216.f));
+}
+
+TARGET("avx2")
+static void UniformsAVX2(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int n)
+{
+    uint32_t low[8], high[8];
+    for (int i = 0; i < n; i += 8)
+    {
+        SampleCounters(firstSample + i, 8, low, high);
+        __m256i c[4] = { _mm256_loadu_si256((const __m256i*)low), _mm256_loadu_si256((const __m256i*)high),
+            _mm256_set1_epi32((int)draw), _mm256_set1_epi32((int)KIND_UNIFORM) };
+        PhiloxAVX2(c, seed);
+        _mm256_storeu_ps(out + i, ToUniformAVX2(c[0]));
+    }
+}
+
+TARGET("avx2")
+static void NormalsAVX2(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int n)
+{
+    const ZigguratTables& z = Ziggurat();
+    uint32_t low[8], high[8];
+    __m256i layerMask = _mm256_set1_epi32(ZIGGURAT_LAYERS - 1);
+    for (int i = 0; i < n; i += 8)
+    {
+        SampleCounters(firstSample + i, 8, low, high);
+        __m256i c[4] = { _mm256_loadu_si256((const __m256i*)low), _mm256_loadu_si256((const __m256i*)high),
+            _mm256_set1_epi32((int)draw), _mm256_set1_epi32((int)KIND_NORMAL) };
+        PhiloxAVX2(c, seed);
+
+        // Fast path of the first attempt, the rejected lanes (~1%) go through the scalar function
+        __m256i iz = _mm256_and_si256(c[1], layerMask);
+        __m256i k = _mm256_i32gather_epi32(z.k, iz, 4);
+        __m256 w = _mm256_i32gather_ps(z.w, iz, 4);
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(c[0]), w));
+        int accepted = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, _mm256_abs_epi32(c[0]))));
+        if (accepted == 0xFF)
+            continue;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if ((accepted & (1 << lane)) == 0)
+                out[i + lane] = RandomNormal(seed, firstSample + i + lane, draw);
+        }
+    }
+}
+
+// gcc headers implement the unmasked AVX-512 intrinsics with an undefined pass-through operand
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+TARGET("avx512f")
+static inline __m512i MulHiAVX512(__m512i a, __m512i m)
+{
+    __m512i even = _mm512_mul_epu32(a, m);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+    return _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+}
+
+TARGET("avx512f")
+static void PhiloxAVX512(__m512i c[4], uint64_t key)
+{
+    __m512i m0 = _mm512_set1_epi32((int)PHILOX_M0);
+    __m512i m1 = _mm512_set1_epi32((int)PHILOX_M1);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        __m512i hi0 = MulHiAVX512(c[0], m0);
+        __m512i lo0 = _mm512_mullo_epi32(c[0], m0);
+        __m512i hi1 = MulHiAVX512(c[2], m1);
+        __m512i lo1 = _mm512_mullo_epi32(c[2], m1);
+        c[0] = _mm512_xor_si512(_mm512_xor_si512(hi1, c[1]), _mm512_set1_epi32((int)k0));
+        c[1] = lo1;
+        c[2] = _mm512_xor_si512(_mm512_xor_si512(hi0, c[3]), _mm512_set1_epi32((int)k1));
+        c[3] = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+TARGET("avx512f")
+static inline __m512 ToUniformAVX512(__m512i bits)
+{
+    __m512i mantissa = _mm512_add_epi32(_mm512_srli_epi32(bits, 8), _mm512_set1_epi32(1));
+    return _mm512_mul_ps(_mm512_cvtepi32_ps(mantissa), _mm512_set1_ps(1.f / 16777216.f));
+}
+
+TARGET("avx512f")
+static void UniformsAVX512(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int n)
+{
+    uint32_t low[16], high[16];
+    for (int i = 0; i < n; i += 16)
+    {
+        SampleCounters(firstSample + i, 16, low, high);
+        __m512i c[4] = { _mm512_loadu_si512(low), _mm512_loadu_si512(high),
+            _mm512_set1_epi32((int)draw), _mm512_set1_epi32((int)KIND_UNIFORM) };
+        PhiloxAVX512(c, seed);
+        _mm512_storeu_ps(out + i, ToUniformAVX512(c[0]));
+    }
+}
+
+TARGET("avx512f")
+static void NormalsAVX512(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int n)
+{
+    const ZigguratTables& z = Ziggurat();
+    uint32_t low[16], high[16];
+    __m512i layerMask = _mm512_set1_epi32(ZIGGURAT_LAYERS - 1);
+    for (int i = 0; i < n; i += 16)
+    {
+        SampleCounters(firstSample + i, 16, low, high);
+        __m512i c[4] = { _mm512_loadu_si512(low), _mm512_loadu_si512(high),
+            _mm512_set1_epi32((int)draw), _mm512_set1_epi32((int)KIND_NORMAL) };
+        PhiloxAVX512(c, seed);
+
+        __m512i iz = _mm512_and_si512(c[1], layerMask);
+        __m512i k = _mm512_i32gather_epi32(iz, z.k, 4);
+        __m512 w = _mm512_i32gather_ps(iz, z.w, 4);
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(c[0]), w));
+        __mmask16 accepted = _mm512_cmpgt_epi32_mask(k, _mm512_abs_epi32(c[0]));
+        if (accepted == 0xFFFF)
+            continue;
+        for (int lane = 0; lane < 16; lane++)
+        {
+            if ((accepted & (1 << lane)) == 0)
+                out[i + lane] = RandomNormal(seed, firstSample + i + lane, draw);
+        }
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Whole vectors, the remainder goes through the scalar functions
+void RandomUniforms(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count, SimdLevel level)
+{
+    int done = 0;
+    switch (level)
+    {
+#if defined(SIMD_X86)
+    case SimdLevel::AVX2:
+        done = count & ~7;
+        UniformsAVX2(seed, firstSample, draw, out, done);
+        break;
+    case SimdLevel::AVX512:
+        done = count & ~15;
+        UniformsAVX512(seed, firstSample, draw, out, done);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (int i = done; i < count; i++)
+        out[i] = RandomUniform(seed, firstSample + i, draw);
+}
+
+void RandomNormals(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count, SimdLevel level)
+{
+    int done = 0;
+    switch (level)
+    {
+#if defined(SIMD_X86)
+    case SimdLevel::AVX2:
+        done = count & ~7;
+        NormalsAVX2(seed, firstSample, draw, out, done);
+        break;
+    case SimdLevel::AVX512:
+        done = count & ~15;
+        NormalsAVX512(seed, firstSample, draw, out, done);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (int i = done; i < count; i++)
+        out[i] = RandomNormal(seed, firstSample + i, draw);
+}
+
+void RandomUniforms(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count)
+{
+    static const SimdLevel level = DetectSimdLevel();
+    RandomUniforms(seed, firstSample, draw, out, count, level);
+}
+
+void RandomNormals(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count)
+{
+    static const SimdLevel level = DetectSimdLevel();
+    RandomNormals(seed, firstSample, draw, out, count, level);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "simd.hpp"
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// A number only depends on (seed, sample, draw). There is no stream state: threads share nothing, any split of
+// the samples gives the same numbers and a single sample can be regenerated on its own.
+// The batch functions return the same bits as the scalar ones, whatever the instruction set.
+
+// Counter words: sample (low, high), draw, (attempt << 2) | kind
+void Philox4x32(const uint32_t counter[4], uint64_t key, uint32_t out[4]);
+
+// 32 random bits, the uniform below is built on them
+uint32_t RandomBits(uint64_t seed, uint64_t sample, uint32_t draw);
+// Uniform in (0, 1], 24 bits
+float RandomUniform(uint64_t seed, uint64_t sample, uint32_t draw);
+// Standard normal, Ziggurat method with 128 layers (only ~1% of the numbers need a transcendental function)
+float RandomNormal(uint64_t seed, uint64_t sample, uint32_t draw);
+
+// Draw number draw of each sample of [firstSample, firstSample + count), 8 (AVX2) or 16 (AVX-512) samples at a time
+void RandomUniforms(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count);
+void RandomNormals(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count);
+// Same, forcing a code path (must be supported by the CPU)
+void RandomUniforms(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count, SimdLevel level);
+void RandomNormals(uint64_t seed, uint64_t firstSample, uint32_t draw, float* out, int count, SimdLevel level);
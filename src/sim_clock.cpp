@@ -0,0 +1,38 @@
+#include "sim_clock.hpp"
+
+FixedStepClock::FixedStepClock(float tickRate, float maxCatchUpTime)
+    : maxCatchUpTime(maxCatchUpTime), tickRate(0.f), tickTime(0.f), accumulator(0.f)
+{
+    SetTickRate(tickRate);
+}
+
+void FixedStepClock::SetTickRate(float newTickRate)
+{
+    if (newTickRate < 1.f)
+        newTickRate = 1.f;
+    if (newTickRate == tickRate)
+        return;
+
+    // Keep the same interpolation factor
+    float alpha = tickTime > 0.f ? Alpha() : 0.f;
+    tickRate = newTickRate;
+    tickTime = 1.f / newTickRate;
+    accumulator = alpha * tickTime;
+}
+
+int FixedStepClock::Advance(float frameTime)
+{
+    if (frameTime > 0.f)
+        accumulator += frameTime;
+
+    int ticks = (int)(accumulator / tickTime);
+    accumulator -= ticks * tickTime;
+
+    // Bounded catch up after a hitch, a time so that a high tick rate keeps up with the normal frames
+    int maxTicks = (int)(maxCatchUpTime * tickRate + 0.5f);
+    maxTicks = maxTicks > 1 ? maxTicks : 1;
+    if (ticks > maxTicks)
+        ticks = maxTicks;
+
+    return ticks;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Fixed timestep clock
+// The frame time is accumulated and consumed by whole ticks, so the simulation does not depend on the frame rate.
+// The renderer interpolates between the last two simulated states with Alpha().
+class FixedStepClock
+{
+public:
+    FixedStepClock(float tickRate = 120.f, float maxCatchUpTime = 0.25f);
+
+    void SetTickRate(float tickRate);
+    float TickRate() const { return tickRate; }
+    float TickTime() const { return tickTime; }
+
+    // Adds the frame time and returns the number of ticks to simulate
+    // At most maxCatchUpTime of ticks are returned whatever the tick rate, the time that could not be caught up is dropped
+    int Advance(float frameTime);
+
+    // Position of the current time between the last simulated tick (0) and the next one (1)
+    float Alpha() const { return accumulator / tickTime; }
+
+    void Reset() { accumulator = 0.f; }
+
+    float maxCatchUpTime; // Simulated time per frame above which the clock slows down (s)
+
+private:
+    float tickRate;
+    float tickTime;
+    float accumulator;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// Instruction sets of the vectorized kernels, each one has a scalar fallback
+enum class SimdLevel
+{
+    Scalar,
+    SSE,
+    AVX2,
+    AVX512,
+};
+
+// Best instruction set supported by this CPU (and OS)
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "calc.hpp"
+#include "simulation.hpp"
+
+const LaunchState& GetLaunchState(Cannon& cannon)
+{
+    LaunchState& launch = cannon.launch;
+    if (launch.valid)
+        return launch;
+
+    launch.trajectory         = SolveTrajectory(cannon);
+    float2 direction          = launch.trajectory.direction;
+    launch.cannonXLength      = direction.x * cannon.L;
+    launch.barrelSpeed        = direction * cannon.v0;
+    launch.barrelAcceleration = direction * -GRAVITY;
+    launch.valid              = true;
+    return launch;
+}
+
+void InvalidateLaunchState(Cannon& cannon)
+{
+    cannon.launch.valid = false;
+}
+
+float GroundContact(const BodyState& start, const BodyState& end, float dt)
+{
+    // Height above the ground as a cubic in s: c0 + c1 s + c2 s^2 + c3 s^3
+    float y0 = start.position.y - GROUND_HEIGHT;
+    float y1 = end.position.y - GROUND_HEIGHT;
+    float m0 = start.velocity.y * dt;
+    float m1 = end.velocity.y * dt;
+    float c1 = m0;
+    float c2 = 3.f * (y1 - y0) - 2.f * m0 - m1;
+    float c3 = 2.f * (y0 - y1) + m0 + m1;
+
+    // Newton from the chord, kept inside the bracket [lo, hi] of the contact by bisection steps
+    float lo = 0.f;
+    float hi = 1.f;
+    float s = y0 / (y0 - y1);
+    for (int i = 0; i < 32; i++)
+    {
+        float y = y0 + s * (c1 + s * (c2 + s * c3));
+        if (y == 0.f)
+            break;
+        if (y > 0.f)
+            lo = s;
+        else
+            hi = s;
+
+        float next = s - y / (c1 + s * (2.f * c2 + 3.f * s * c3));
+        if (!(next > lo && next < hi))
+            next = 0.5f * (lo + hi);
+        bool converged = fabsf(next - s) < 1e-7f;
+        s = next;
+        if (converged)
+            break;
+    }
+    return s;
+}
+
+bool UpdateProjectile(Cannon &cannon, float2 &projectilePos, float &prevTime, float &time)
+{
+    Projectile* projectile = &cannon.projectile;
+    const LaunchState& launch = GetLaunchState(cannon);
+
+    //We check if the projectile is at 0 minus the radius
+    bool isFinished = projectilePos.y < GROUND_HEIGHT;
+
+    // Or if the projectile went backwards in the cannon then we now if we should stop
+    isFinished |= projectilePos.x - cannon.p0.x < 0;
+
+    //We check if the position in x is bigger than the cannon length in x
+    bool isInsideCanon = projectilePos.x - cannon.p0.x < launch.cannonXLength;
+
+    // v^2 - v0^2 = 2aL, the projectile only leaves the barrel if v^2 > 0
+    bool canBeOutOfCannon = launch.trajectory.exits;
+
+    // A step starting in the barrel may end past the exit: the barrel segment is cut at exitTime and the rest
+    // of the step follows the free flight, so the ground contact is solved on the right curve
+    bool hasLeftBarrel = canBeOutOfCannon && time >= launch.trajectory.exitTime;
+
+    float2 p0 = cannon.p0;
+    float2 v0 = projectile->speed;
+    float t = time;
+
+    if (isFinished)
+    {
+        projectile->launched = false;
+        return (false);
+    }
+    else if (isInsideCanon && !hasLeftBarrel)
+    {
+        v0 = projectile->speed = launch.barrelSpeed;
+        projectile->acceleration = launch.barrelAcceleration;
+        prevTime = time;
+    }
+    else if (canBeOutOfCannon)
+    {
+        p0 = launch.trajectory.exitPoint;
+        // The free flight starts at the exact exit time, not at the last step inside the barrel
+        t = time - launch.trajectory.exitTime;
+        v0 = projectile->speed = launch.trajectory.exitSpeed;
+        projectile->acceleration = { 0, -GRAVITY };
+    }
+
+    //p(t) = p0 + v0 * t + (a * t^2 * 0.5f)
+    projectilePos =  p0 + v0 * t + (projectile->acceleration * t * t * 0.5f);
+
+    // Continuous collision: a step crossing the ground stops on the exact contact, whatever its length
+    // The piece of the phase from its start to now goes from above the ground to below it
+    bool stopped = false;
+    if (projectilePos.y < GROUND_HEIGHT)
+    {
+        BodyState start = { p0, v0 };
+        BodyState end = { projectilePos, v0 + projectile->acceleration * t };
+        float contact = t * GroundContact(start, end, t);
+        time += contact - t;
+        projectilePos = p0 + v0 * contact + (projectile->acceleration * contact * contact * 0.5f);
+        projectilePos.y = GROUND_HEIGHT;
+        stopped = true;
+    }
+    // Too slow to leave the barrel: back at the breech after exactly impactTime
+    else if (!canBeOutOfCannon && time >= launch.trajectory.impactTime)
+    {
+        time = launch.trajectory.impactTime;
+        projectilePos = cannon.p0;
+        stopped = true;
+    }
+
+    cannon.position = cannon.p0 + launch.trajectory.recoilSpeed * time;
+    if (stopped)
+    {
+        projectile->launched = false;
+        return (false);
+    }
+    return (true);
+}
+
+Trajectory SolveTrajectory(const Cannon& cannon)
+{
+    Trajectory traj = {};
+    traj.p0 = cannon.p0;
+    traj.direction = { cosf(cannon.angle), sinf(cannon.angle) };
+    traj.v0 = cannon.v0;
+
+    // Inside the barrel the projectile decelerates by GRAVITY along the barrel:
+    // s(t) = v0 * t - g * t^2 / 2, it leaves the barrel when s(t) = L with v = sqrt(v0^2 - 2gL)
+    float exitSpeed2 = cannon.v0 * cannon.v0 - 2.f * GRAVITY * cannon.L;
+    traj.exits = exitSpeed2 > 0.f;
+
+    if (traj.exits)
+    {
+        float exitSpeed = sqrtf(exitSpeed2);
+        traj.exitTime  = (cannon.v0 - exitSpeed) / GRAVITY;
+        traj.exitPoint = cannon.p0 + traj.direction * cannon.L;
+        traj.exitSpeed = traj.direction * exitSpeed;
+
+        // Ballistic phase: y(t) = exit.y + vy * t - g * t^2 / 2, highest point at vy = 0
+        float vy = traj.exitSpeed.y;
+        float apexTime = fmaxf(vy / GRAVITY, 0.f);
+        traj.apexTime = traj.exitTime + apexTime;
+        traj.apex = traj.exitPoint + traj.exitSpeed * apexTime + float2{ 0.f, -0.5f * GRAVITY * apexTime * apexTime };
+
+        // Positive root of y(t) = GROUND_HEIGHT
+        float height = traj.exitPoint.y - GROUND_HEIGHT;
+        float flightTime = (vy + sqrtf(fmaxf(vy * vy + 2.f * GRAVITY * height, 0.f))) / GRAVITY;
+        traj.impactTime = traj.exitTime + flightTime;
+        traj.impact = traj.exitPoint + traj.exitSpeed * flightTime + float2{ 0.f, -0.5f * GRAVITY * flightTime * flightTime };
+    }
+    else
+    {
+        // Stops at s = v0^2 / 2g then slides back to the breech
+        traj.exitTime   = traj.impactTime = 2.f * cannon.v0 / GRAVITY;
+        traj.exitPoint  = traj.impact = cannon.p0;
+        traj.exitSpeed  = traj.direction * -cannon.v0;
+        traj.apexTime   = cannon.v0 / GRAVITY;
+        traj.apex       = cannon.p0 + traj.direction * (cannon.v0 * cannon.v0 / (2.f * GRAVITY));
+    }
+
+    //Inelastic collision : Qac+ Qab = Qqpc + QqpB ; m*v0 = mv+mv` ; v` = m(v0 - v) / M
+    //In our case both our initial speeds are 0 before collision
+    traj.recoilSpeed = { cannon.projectile.mass * (-cannon.v0) / cannon.M * traj.direction.x, 0.f };
+
+    return traj;
+}
+
+float2 TrajectoryPosition(const Trajectory& traj, float time)
+{
+    float t = fminf(fmaxf(time, 0.f), traj.impactTime);
+    if (t < traj.exitTime)
+        return traj.p0 + traj.direction * (traj.v0 * t - 0.5f * GRAVITY * t * t);
+
+    t -= traj.exitTime;
+    return traj.exitPoint + traj.exitSpeed * t + float2{ 0.f, -0.5f * GRAVITY * t * t };
+}
+
+float2 TrajectorySpeed(const Trajectory& traj, float time)
+{
+    float t = fminf(fmaxf(time, 0.f), traj.impactTime);
+    if (t < traj.exitTime)
+        return traj.direction * (traj.v0 - GRAVITY * t);
+
+    t -= traj.exitTime;
+    return traj.exitSpeed + float2{ 0.f, -GRAVITY * t };
+}
+
+float2 TrajectoryAcceleration(const Trajectory& traj, float time)
+{
+    if (time < traj.exitTime)
+        return traj.direction * -GRAVITY;
+    return { 0.f, -GRAVITY };
+}
+
+void TrajectoryBezier(const Trajectory& traj, float2 control[3])
+{
+    // B(s) = exit + speed * T * s - g * T^2 * s^2 / 2 with s = t / T
+    float flightTime = traj.impactTime - traj.exitTime;
+    control[0] = traj.exitPoint;
+    control[1] = traj.exitPoint + traj.exitSpeed * (flightTime * 0.5f);
+    control[2] = traj.impact;
+}
+
+void TessellateTrajectory(const Trajectory& traj, float tolerance, std::vector<float2>& points)
+{
+    points.clear();
+    points.push_back(traj.p0);
+    points.push_back(traj.exits ? traj.exitPoint : traj.apex);
+    if (!traj.exits)
+        return;
+
+    float2 c[3];
+    TrajectoryBezier(traj, c);
+
+    // Chord error of n uniform segments is |p0 - 2p1 + p2| / (4n^2)
+    float2 d = c[0] - c[1] * 2.f + c[2];
+    int segments = (int)ceilf(sqrtf(length(d) / (4.f * tolerance)));
+    if (segments < 1)
+        segments = 1;
+
+    for (int i = 1; i <= segments; i++)
+    {
+        float t = (float)i / segments;
+        float u = 1.f - t;
+        points.push_back(c[0] * (u * u) + c[1] * (2.f * u * t) + c[2] * (t * t));
+    }
+}
+
+void SimulateBatch(const Cannon* cannons, ShotResult* results, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        Trajectory traj = SolveTrajectory(cannons[i]);
+
+        ShotResult& result = results[i];
+        result.landed     = traj.exits;
+        result.flightTime = traj.impactTime;
+        result.impact     = traj.impact;
+        result.recoil     = traj.recoilSpeed * traj.impactTime;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+
+#include "types.hpp"
+
+class WindField;
+
+struct Projectile
+{
+    bool launched;
+    float mass;
+    float2 position, speed, acceleration, dSpeed;
+    float speedMagnitude;
+};
+
+// Closed form description of a shot: barrel phase then ballistic phase, both quadratic in time
+struct Trajectory
+{
+    bool exits;         // false if the projectile is too slow to leave the barrel and falls back out of the breech
+    float2 p0;          // Breech position at launch
+    float2 direction;   // Barrel direction { cos(angle), sin(angle) }
+    float v0;           // Launch speed along the barrel
+    float exitTime;     // Time at which the projectile leaves the barrel
+    float2 exitPoint;
+    float2 exitSpeed;   // Velocity when leaving the barrel
+    float apexTime;     // Time of the highest point
+    float2 apex;
+    float impactTime;   // Time of flight, until the ground plane (or back to the breech if !exits)
+    float2 impact;
+    float2 recoilSpeed; // Cannon velocity after the shot
+};
+
+// Values derived from the cannon parameters, they do not change during a shot
+// Computed once by GetLaunchState, the settings window invalidates them when a parameter changes
+struct LaunchState
+{
+    bool valid;
+    float cannonXLength;       // Barrel length along x
+    float2 barrelSpeed;        // Launch velocity
+    float2 barrelAcceleration; // Deceleration along the barrel
+    Trajectory trajectory;     // Exact shot (direction, exit point and speed, recoil speed...)
+};
+
+// Quadratic air drag on the projectile: F = -rho * Cd * A * |v| * v / 2
+struct AirDrag
+{
+    bool enabled;          // Vacuum (closed form trajectory) otherwise
+    float dragCoefficient; // Cd, 0.47 for a sphere
+    float area;            // Cross section (m^2)
+    float airDensity;      // kg/m^3, 1.225 at sea level
+    const WindField* wind; // The drag acts on the velocity relative to this wind, still air if nullptr
+    float windScale;       // Multiplies the sampled wind
+};
+
+struct Cannon
+{
+    float2 p0, position;
+    float angle, v0, L, M;
+    Projectile projectile;
+    AirDrag drag;
+    LaunchState launch; // Cache, use GetLaunchState
+};
+
+// Point mass
+struct BodyState
+{
+    float2 position;
+    float2 velocity;
+};
+
+// Outcome of one shot simulated without rendering
+struct ShotResult
+{
+    bool landed;      // false if the shot never reached the ground (fell back out of the barrel)
+    float flightTime; // Time of flight (seconds)
+    float2 impact;    // Final position of the projectile (meters)
+    float2 recoil;    // Displacement of the cannon from p0 at that time (meters)
+};
+
+// Exact barrel exit, apex and impact of the shot in O(1)
+Trajectory SolveTrajectory(const Cannon& cannon);
+
+// State of the projectile at a given time since launch (clamped to [0, impactTime])
+float2 TrajectoryPosition(const Trajectory& trajectory, float time);
+float2 TrajectorySpeed(const Trajectory& trajectory, float time);
+float2 TrajectoryAcceleration(const Trajectory& trajectory, float time);
+
+// Control points of the ballistic phase, a parabola is exactly a quadratic Bezier curve
+void TrajectoryBezier(const Trajectory& trajectory, float2 control[3]);
+
+// World space polyline of the whole shot, no point is further than tolerance (meters) from the curve
+void TessellateTrajectory(const Trajectory& trajectory, float tolerance, std::vector<float2>& points);
+
+// Launch state of the cannon, only recomputed after InvalidateLaunchState
+const LaunchState& GetLaunchState(Cannon& cannon);
+void InvalidateLaunchState(Cannon& cannon);
+
+// Fraction in [0, 1] of a step of dt seconds at which the body reaches the ground plane, start above it and end on or
+// below it. The path is the cubic Hermite interpolation of the two states, exact on a quadratic closed form piece.
+// The contact solve of every stepped path: UpdateProjectile, IntegrateFlight and the salvo pool
+float GroundContact(const BodyState& start, const BodyState& end, float dt);
+
+// Stepped simulation, returns false once the projectile stopped
+// A step crossing the ground (or the breech) ends on the exact contact: projectilePos and time are snapped to it
+bool UpdateProjectile(Cannon &cannon, float2 &projectilePos, float &prevTime, float &time);
+
+// Solve every shot of the batch
+void SimulateBatch(const Cannon* cannons, ShotResult* results, int count);
@@ -0,0 +1,54 @@
+#include "sweep.hpp"
+
+static int RangeSteps(const SweepRange& range)
+{
+    return range.steps > 1 ? range.steps : 1;
+}
+
+static float RangeValue(const SweepRange& range, int step)
+{
+    if (range.steps <= 1)
+        return range.min;
+    return range.min + (range.max - range.min) * step / (range.steps - 1);
+}
+
+int SweepCount(const ShotSweep& sweep)
+{
+    return RangeSteps(sweep.angle) * RangeSteps(sweep.v0) * RangeSteps(sweep.L) * RangeSteps(sweep.M) * RangeSteps(sweep.mass);
+}
+
+Cannon SweepCannon(const ShotSweep& sweep, int index)
+{
+    Cannon cannon = sweep.base;
+
+    const SweepRange* ranges[5] = { &sweep.mass, &sweep.M, &sweep.L, &sweep.v0, &sweep.angle };
+    float* values[5] = { &cannon.projectile.mass, &cannon.M, &cannon.L, &cannon.v0, &cannon.angle };
+    for (int i = 0; i < 5; i++)
+    {
+        int steps = RangeSteps(*ranges[i]);
+        *values[i] = RangeValue(*ranges[i], index % steps);
+        index /= steps;
+    }
+
+    return cannon;
+}
+
+void SimulateBatchParallel(JobSystem& jobs, const Cannon* cannons, ShotResult* results, int count, int grainSize)
+{
+    jobs.ParallelFor(count, grainSize, [&](int begin, int end)
+    {
+        SimulateBatch(cannons + begin, results + begin, end - begin);
+    });
+}
+
+void RunSweep(JobSystem& jobs, const ShotSweep& sweep, ShotResult* results, int grainSize)
+{
+    jobs.ParallelFor(SweepCount(sweep), grainSize, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            Cannon cannon = SweepCannon(sweep, i);
+            SimulateBatch(&cannon, results + i, 1);
+        }
+    });
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "simulation.hpp"
+
+// Parameter sampled linearly from min to max (steps <= 1 keeps min)
+struct SweepRange
+{
+    float min;
+    float max;
+    int steps;
+};
+
+// Every combination of the cannon parameters exposed in the settings window
+// Index order: mass varies fastest, then M, L, v0 and angle
+struct ShotSweep
+{
+    Cannon base;
+    SweepRange angle, v0, L, M, mass;
+};
+
+int SweepCount(const ShotSweep& sweep);
+Cannon SweepCannon(const ShotSweep& sweep, int index);
+
+// Same as SimulateBatch, split across the job system (results stay in input order)
+void SimulateBatchParallel(JobSystem& jobs, const Cannon* cannons, ShotResult* results, int count, int grainSize = 4096);
+
+// Solve every shot of the sweep, results must hold SweepCount(sweep) elements
+void RunSweep(JobSystem& jobs, const ShotSweep& sweep, ShotResult* results, int grainSize = 4096);
@@ -1,12 +1,17 @@
 #pragma once
 
+// Headless builds (SIM_HEADLESS) must not depend on ImGui
+#ifndef SIM_HEADLESS
 #include <imgui.h>
+#endif
 
 struct float2
 {
     float x;
     float y;
 
+#ifndef SIM_HEADLESS
     // Cast operator
     operator ImVec2() { return { x, y }; }
+#endif
 };
@@ -0,0 +1,376 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "calc.hpp"
+#include "wind_field.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic without target flags, gcc/clang need the attribute on the function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define N_GUSTS 3
+
+static std::atomic<uint32_t> nextId(1);
+
+WindField::WindField()
+    : nx(0), ny(0), tilesX(0), min{ 0.f, 0.f }, cellSize(1.f), invCellSize(1.f), id(0)
+{
+}
+
+void WindField::Resize(int width, int height, float2 origin, float cell)
+{
+    nx = width;
+    ny = height;
+    tilesX = (width + WIND_TILE_SIZE - 1) / WIND_TILE_SIZE;
+    int tilesY = (height + WIND_TILE_SIZE - 1) / WIND_TILE_SIZE;
+    min = origin;
+    cellSize = cell;
+    invCellSize = 1.f / cell;
+    id = nextId++;
+    u.assign((size_t)tilesX * tilesY * WIND_TILE_POINTS, 0.f);
+    v.assign(u.size(), 0.f);
+}
+
+int WindField::Index(int i, int j) const
+{
+    int tile = (j / WIND_TILE_SIZE) * tilesX + i / WIND_TILE_SIZE;
+    return tile * WIND_TILE_POINTS + (j % WIND_TILE_SIZE) * WIND_TILE_SIZE + i % WIND_TILE_SIZE;
+}
+
+// xorshift32, the gusts only need a few well spread numbers in [0, 1)
+static float NextRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.f / 16777216.f);
+}
+
+void WindField::Generate(const WindSettings& settings, float2 gridMin, float2 gridMax, float cell)
+{
+    int width = (int)ceilf((gridMax.x - gridMin.x) / cell) + 1;
+    int height = (int)ceilf((gridMax.y - gridMin.y) / cell) + 1;
+    Resize(width < 2 ? 2 : width, height < 2 ? 2 : height, gridMin, cell);
+
+    // Plane waves of random direction, wavelength and phase
+    uint32_t state = settings.seed != 0 ? settings.seed : 1;
+    float2 waveVector[N_GUSTS];
+    float phaseU[N_GUSTS], phaseV[N_GUSTS];
+    for (int g = 0; g < N_GUSTS; g++)
+    {
+        float angle = NextRandom(state) * TAU;
+        float wavelength = settings.gustLength * (0.5f + NextRandom(state));
+        waveVector[g] = float2{ cosf(angle), sinf(angle) } * (TAU / wavelength);
+        phaseU[g] = NextRandom(state) * TAU;
+        phaseV[g] = NextRandom(state) * TAU;
+    }
+
+    float z0 = fmaxf(settings.roughness, 1e-4f);
+    float reference = logf(10.f / z0);
+    for (int j = 0; j < ny; j++)
+    {
+        float y = min.y + j * cellSize;
+        // No wind under the roughness length, vertical gusts fade out close to the ground
+        float height = y - GROUND_HEIGHT;
+        float profile = height > z0 ? logf(height / z0) / reference : 0.f;
+        float vertical = fminf(fmaxf(height / 10.f, 0.f), 1.f);
+        for (int i = 0; i < nx; i++)
+        {
+            float2 p = { min.x + i * cellSize, y };
+            float gustU = 0.f, gustV = 0.f;
+            for (int g = 0; g < N_GUSTS; g++)
+            {
+                float phase = waveVector[g].x * p.x + waveVector[g].y * p.y;
+                gustU += sinf(phase + phaseU[g]);
+                gustV += sinf(phase + phaseV[g]);
+            }
+
+            int index = Index(i, j);
+            u[index] = (settings.speed + settings.gust * gustU / N_GUSTS) * profile;
+            v[index] = settings.gust * 0.3f * gustV / N_GUSTS * vertical;
+        }
+    }
+}
+
+// Next number of a text buffer, skipping blanks and '#' comments
+static bool ParseNumber(const char*& cursor, float& value)
+{
+    while (*cursor != '\0')
+    {
+        if (*cursor == '#')
+        {
+            while (*cursor != '\0' && *cursor != '\n')
+                cursor++;
+        }
+        else if (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n')
+        {
+            cursor++;
+        }
+        else
+        {
+            char* end;
+            value = strtof(cursor, &end);
+            if (end == cursor)
+                return false;
+            cursor = end;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WindField::Load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    std::vector<char> text;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.insert(text.end(), buffer, buffer + read);
+    fclose(file);
+    text.push_back('\0');
+
+    const char* cursor = text.data();
+    float header[5];
+    for (float& value : header)
+    {
+        if (!ParseNumber(cursor, value))
+        {
+            fprintf(stderr, "'%s': expected \"nx ny minX minY cellSize\"\n", path);
+            return false;
+        }
+    }
+
+    int width = (int)header[0];
+    int height = (int)header[1];
+    if (width < 2 || height < 2 || header[4] <= 0.f)
+    {
+        fprintf(stderr, "'%s': invalid grid %dx%d (cell size %g)\n", path, width, height, header[4]);
+        return false;
+    }
+
+    std::vector<float> values((size_t)width * height * 2);
+    for (size_t k = 0; k < values.size(); k++)
+    {
+        if (!ParseNumber(cursor, values[k]))
+        {
+            fprintf(stderr, "'%s': expected %d wind vectors, got %zu\n", path, width * height, k / 2);
+            return false;
+        }
+    }
+
+    Resize(width, height, { header[2], header[3] }, header[4]);
+    for (int j = 0; j < ny; j++)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            size_t k = ((size_t)j * nx + i) * 2;
+            u[Index(i, j)] = values[k];
+            v[Index(i, j)] = values[k + 1];
+        }
+    }
+    return true;
+}
+
+float2 WindField::Sample(float2 position) const
+{
+    if (IsEmpty())
+        return { 0.f, 0.f };
+
+    // Cell and position inside it, the border cells extend outside the grid
+    float gx = fminf(fmaxf((position.x - min.x) * invCellSize, 0.f), (float)(nx - 1));
+    float gy = fminf(fmaxf((position.y - min.y) * invCellSize, 0.f), (float)(ny - 1));
+    int i = (int)gx < nx - 2 ? (int)gx : nx - 2;
+    int j = (int)gy < ny - 2 ? (int)gy : ny - 2;
+    float fx = gx - i;
+    float fy = gy - j;
+
+    int i00 = Index(i, j), i10 = Index(i + 1, j), i01 = Index(i, j + 1), i11 = Index(i + 1, j + 1);
+    float u0 = u[i00] + (u[i10] - u[i00]) * fx;
+    float u1 = u[i01] + (u[i11] - u[i01]) * fx;
+    float v0 = v[i00] + (v[i10] - v[i00]) * fx;
+    float v1 = v[i01] + (v[i11] - v[i01]) * fx;
+    return { u0 + (u1 - u0) * fy, v0 + (v1 - v0) * fy };
+}
+
+#if defined(SIMD_X86)
+// Tiled index of the grid point (i, j), i and j are in [0, nx) and [0, ny)
+TARGET("avx2,fma")
+static inline __m256i TileIndexAVX2(__m256i i, __m256i j, __m256i tilesX)
+{
+    __m256i mask = _mm256_set1_epi32(WIND_TILE_SIZE - 1);
+    __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(j, 3), tilesX), _mm256_srli_epi32(i, 3));
+    __m256i local = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(j, mask), 3), _mm256_and_si256(i, mask));
+    return _mm256_add_epi32(_mm256_slli_epi32(tile, 6), local);
+}
+
+TARGET("avx2,fma")
+static void SampleAVX2(const float* gridU, const float* gridV, int nx, int ny, int tilesX, float2 min, float invCellSize,
+    const float* x, const float* y, float* u, float* v, int n)
+{
+    __m256 minX = _mm256_set1_ps(min.x);
+    __m256 minY = _mm256_set1_ps(min.y);
+    __m256 inv = _mm256_set1_ps(invCellSize);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 lastX = _mm256_set1_ps((float)(nx - 1));
+    __m256 lastY = _mm256_set1_ps((float)(ny - 1));
+    __m256i lastCellX = _mm256_set1_epi32(nx - 2);
+    __m256i lastCellY = _mm256_set1_epi32(ny - 2);
+    __m256i tiles = _mm256_set1_epi32(tilesX);
+    __m256i one = _mm256_set1_epi32(1);
+    for (int k = 0; k < n; k += 8)
+    {
+        __m256 gx = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + k), minX), inv), zero), lastX);
+        __m256 gy = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(y + k), minY), inv), zero), lastY);
+        __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(gx), lastCellX);
+        __m256i j = _mm256_min_epi32(_mm256_cvttps_epi32(gy), lastCellY);
+        __m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(i));
+        __m256 fy = _mm256_sub_ps(gy, _mm256_cvtepi32_ps(j));
+
+        __m256i i1 = _mm256_add_epi32(i, one);
+        __m256i j1 = _mm256_add_epi32(j, one);
+        __m256i i00 = TileIndexAVX2(i, j, tiles);
+        __m256i i10 = TileIndexAVX2(i1, j, tiles);
+        __m256i i01 = TileIndexAVX2(i, j1, tiles);
+        __m256i i11 = TileIndexAVX2(i1, j1, tiles);
+
+        __m256 u00 = _mm256_i32gather_ps(gridU, i00, 4);
+        __m256 u10 = _mm256_i32gather_ps(gridU, i10, 4);
+        __m256 u01 = _mm256_i32gather_ps(gridU, i01, 4);
+        __m256 u11 = _mm256_i32gather_ps(gridU, i11, 4);
+        __m256 u0 = _mm256_fmadd_ps(_mm256_sub_ps(u10, u00), fx, u00);
+        __m256 u1 = _mm256_fmadd_ps(_mm256_sub_ps(u11, u01), fx, u01);
+        _mm256_storeu_ps(u + k, _mm256_fmadd_ps(_mm256_sub_ps(u1, u0), fy, u0));
+
+        __m256 v00 = _mm256_i32gather_ps(gridV, i00, 4);
+        __m256 v10 = _mm256_i32gather_ps(gridV, i10, 4);
+        __m256 v01 = _mm256_i32gather_ps(gridV, i01, 4);
+        __m256 v11 = _mm256_i32gather_ps(gridV, i11, 4);
+        __m256 v0 = _mm256_fmadd_ps(_mm256_sub_ps(v10, v00), fx, v00);
+        __m256 v1 = _mm256_fmadd_ps(_mm256_sub_ps(v11, v01), fx, v01);
+        _mm256_storeu_ps(v + k, _mm256_fmadd_ps(_mm256_sub_ps(v1, v0), fy, v0));
+    }
+}
+
+// gcc headers implement the unmasked AVX-512 intrinsics with an undefined pass-through operand
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+TARGET("avx512f")
+static inline __m512i TileIndexAVX512(__m512i i, __m512i j, __m512i tilesX)
+{
+    __m512i mask = _mm512_set1_epi32(WIND_TILE_SIZE - 1);
+    __m512i tile = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_srli_epi32(j, 3), tilesX), _mm512_srli_epi32(i, 3));
+    __m512i local = _mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(j, mask), 3), _mm512_and_si512(i, mask));
+    return _mm512_add_epi32(_mm512_slli_epi32(tile, 6), local);
+}
+
+TARGET("avx512f")
+static void SampleAVX512(const float* gridU, const float* gridV, int nx, int ny, int tilesX, float2 min, float invCellSize,
+    const float* x, const float* y, float* u, float* v, int n)
+{
+    __m512 minX = _mm512_set1_ps(min.x);
+    __m512 minY = _mm512_set1_ps(min.y);
+    __m512 inv = _mm512_set1_ps(invCellSize);
+    __m512 zero = _mm512_setzero_ps();
+    __m512 lastX = _mm512_set1_ps((float)(nx - 1));
+    __m512 lastY = _mm512_set1_ps((float)(ny - 1));
+    __m512i lastCellX = _mm512_set1_epi32(nx - 2);
+    __m512i lastCellY = _mm512_set1_epi32(ny - 2);
+    __m512i tiles = _mm512_set1_epi32(tilesX);
+    __m512i one = _mm512_set1_epi32(1);
+    for (int k = 0; k < n; k += 16)
+    {
+        __m512 gx = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(x + k), minX), inv), zero), lastX);
+        __m512 gy = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(y + k), minY), inv), zero), lastY);
+        __m512i i = _mm512_min_epi32(_mm512_cvttps_epi32(gx), lastCellX);
+        __m512i j = _mm512_min_epi32(_mm512_cvttps_epi32(gy), lastCellY);
+        __m512 fx = _mm512_sub_ps(gx, _mm512_cvtepi32_ps(i));
+        __m512 fy = _mm512_sub_ps(gy, _mm512_cvtepi32_ps(j));
+
+        __m512i i1 = _mm512_add_epi32(i, one);
+        __m512i j1 = _mm512_add_epi32(j, one);
+        __m512i i00 = TileIndexAVX512(i, j, tiles);
+        __m512i i10 = TileIndexAVX512(i1, j, tiles);
+        __m512i i01 = TileIndexAVX512(i, j1, tiles);
+        __m512i i11 = TileIndexAVX512(i1, j1, tiles);
+
+        __m512 u00 = _mm512_i32gather_ps(i00, gridU, 4);
+        __m512 u10 = _mm512_i32gather_ps(i10, gridU, 4);
+        __m512 u01 = _mm512_i32gather_ps(i01, gridU, 4);
+        __m512 u11 = _mm512_i32gather_ps(i11, gridU, 4);
+        __m512 u0 = _mm512_fmadd_ps(_mm512_sub_ps(u10, u00), fx, u00);
+        __m512 u1 = _mm512_fmadd_ps(_mm512_sub_ps(u11, u01), fx, u01);
+        _mm512_storeu_ps(u + k, _mm512_fmadd_ps(_mm512_sub_ps(u1, u0), fy, u0));
+
+        __m512 v00 = _mm512_i32gather_ps(i00, gridV, 4);
+        __m512 v10 = _mm512_i32gather_ps(i10, gridV, 4);
+        __m512 v01 = _mm512_i32gather_ps(i01, gridV, 4);
+        __m512 v11 = _mm512_i32gather_ps(i11, gridV, 4);
+        __m512 v0 = _mm512_fmadd_ps(_mm512_sub_ps(v10, v00), fx, v00);
+        __m512 v1 = _mm512_fmadd_ps(_mm512_sub_ps(v11, v01), fx, v01);
+        _mm512_storeu_ps(v + k, _mm512_fmadd_ps(_mm512_sub_ps(v1, v0), fy, v0));
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+void WindField::Sample(const float* x, const float* y, float* outU, float* outV, int count, SimdLevel level) const
+{
+    if (IsEmpty())
+    {
+        memset(outU, 0, count * sizeof(float));
+        memset(outV, 0, count * sizeof(float));
+        return;
+    }
+
+    // Whole vectors, the remainder goes through the scalar path
+    int done = 0;
+    switch (level)
+    {
+#if defined(SIMD_X86)
+    case SimdLevel::AVX2:
+        done = count & ~7;
+        SampleAVX2(u.data(), v.data(), nx, ny, tilesX, min, invCellSize, x, y, outU, outV, done);
+        break;
+    case SimdLevel::AVX512:
+        done = count & ~15;
+        SampleAVX512(u.data(), v.data(), nx, ny, tilesX, min, invCellSize, x, y, outU, outV, done);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for (int k = done; k < count; k++)
+    {
+        float2 wind = Sample(float2{ x[k], y[k] });
+        outU[k] = wind.x;
+        outV[k] = wind.y;
+    }
+}
+
+void WindField::Sample(const float* x, const float* y, float* outU, float* outV, int count) const
+{
+    static const SimdLevel level = DetectSimdLevel();
+    Sample(x, y, outU, outV, count, level);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "simd.hpp"
+#include "types.hpp"
+
+// Grid points of a tile side, a tile of both components is 8 cache lines
+#define WIND_TILE_SIZE 8
+#define WIND_TILE_POINTS (WIND_TILE_SIZE * WIND_TILE_SIZE)
+
+// Procedural wind: logarithmic boundary layer profile with sinusoidal gusts
+struct WindSettings
+{
+    float speed = 8.f;         // Horizontal wind 10 m above the ground (m/s), negative blows to -x
+    float gust = 3.f;          // Amplitude of the gusts (m/s)
+    float gustLength = 120.f;  // Typical size of a gust (m)
+    float roughness = 0.1f;    // Roughness length of the ground (m)
+    uint32_t seed = 1;
+};
+
+// 2D wind velocity grid, bilinearly interpolated
+// The grid is stored in square tiles so the four corners of a sample (and the samples of projectiles
+// flying close to each other) share cache lines. Positions outside the grid get the value of its border.
+// The data is never modified after Generate/Load: a field can be sampled from any thread.
+class WindField
+{
+public:
+    WindField();
+
+    // Grid of points spaced by cellSize meters covering [min, max]
+    void Generate(const WindSettings& settings, float2 min, float2 max, float cellSize);
+
+    // Text file: "nx ny minX minY cellSize" then nx * ny lines of "u v", rows from minY up ('#' starts a comment)
+    // Returns false (field unchanged) if the file can't be opened or is malformed
+    bool Load(const char* path);
+
+    float2 Sample(float2 position) const;
+
+    // Samples count positions given as separate x and y arrays, 8 (AVX2) or 16 (AVX-512) at a time
+    void Sample(const float* x, const float* y, float* u, float* v, int count) const;
+    // Same, forcing a code path (must be supported by the CPU)
+    void Sample(const float* x, const float* y, float* u, float* v, int count, SimdLevel level) const;
+
+    bool IsEmpty() const { return nx < 2 || ny < 2; }
+    float2 Min() const { return min; }
+    float2 Max() const { return { min.x + (nx - 1) * cellSize, min.y + (ny - 1) * cellSize }; }
+    float CellSize() const { return cellSize; }
+    // Changes with the data of the field, unique among the fields of the process
+    uint32_t Id() const { return id; }
+
+private:
+    void Resize(int width, int height, float2 origin, float cell);
+    int Index(int i, int j) const;
+
+    int nx, ny;          // Grid points
+    int tilesX;
+    float2 min;
+    float cellSize;
+    float invCellSize;
+    uint32_t id;
+    std::vector<float> u; // Tiled, WIND_TILE_POINTS per tile, row-major inside a tile
+    std::vector<float> v;
+};